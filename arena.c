@@ -0,0 +1,129 @@
+/*---------------------------------------------------------------------------*/
+/* arena.c                                                                   */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "arena.h"
+
+enum {CHUNK_SIZE = 8192};
+enum {ALIGNMENT = 16};
+
+struct ArenaChunk {
+    struct ArenaChunk *next;
+
+    /* Usable bytes in data[] and how many of them are handed out */
+    size_t size;
+    size_t used;
+
+    /* Keep data[] aligned for any type */
+    _Alignas(ALIGNMENT) char data[];
+};
+
+struct Arena {
+    /* First chunk; allocation restarts here after a reset */
+    struct ArenaChunk *head;
+
+    /* Chunk currently being carved */
+    struct ArenaChunk *cur;
+};
+
+/*---------------------------------------------------------------------------*/
+static struct ArenaChunk *chunk_new(size_t size) {
+    struct ArenaChunk *c;
+
+    if (size < CHUNK_SIZE)
+        size = CHUNK_SIZE;
+
+    c = malloc(sizeof(struct ArenaChunk) + size);
+    if (c == NULL)
+        return NULL;
+
+    c->next = NULL;
+    c->size = size;
+    c->used = 0;
+
+    return c;
+}
+/*---------------------------------------------------------------------------*/
+Arena_T arena_new(void) {
+    Arena_T oArena;
+
+    oArena = malloc(sizeof(struct Arena));
+    if (oArena == NULL)
+        return NULL;
+
+    oArena->head = chunk_new(CHUNK_SIZE);
+    if (oArena->head == NULL) {
+        free(oArena);
+        return NULL;
+    }
+    oArena->cur = oArena->head;
+
+    return oArena;
+}
+/*---------------------------------------------------------------------------*/
+void arena_free(Arena_T oArena) {
+    struct ArenaChunk *c, *next;
+
+    if (oArena == NULL)
+        return;
+
+    for (c = oArena->head; c != NULL; c = next) {
+        next = c->next;
+        free(c);
+    }
+    free(oArena);
+}
+/*---------------------------------------------------------------------------*/
+void *arena_alloc(Arena_T oArena, size_t size) {
+    struct ArenaChunk *c;
+    void *p;
+
+    assert(oArena != NULL);
+
+    size = (size + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1);
+    c = oArena->cur;
+
+    if (c->size - c->used < size) {
+        /* Reuse the chunk kept from earlier lines if it is big enough,
+           otherwise splice a fresh one in after the current chunk. */
+        c = c->next;
+        if (c == NULL || c->size < size) {
+            c = chunk_new(size);
+            if (c == NULL)
+                return NULL;
+            c->next = oArena->cur->next;
+            oArena->cur->next = c;
+        }
+        c->used = 0;
+        oArena->cur = c;
+    }
+
+    p = c->data + c->used;
+    c->used += size;
+
+    return p;
+}
+/*---------------------------------------------------------------------------*/
+char *arena_strdup(Arena_T oArena, const char *s) {
+    size_t len = strlen(s) + 1;
+    char *copy;
+
+    copy = arena_alloc(oArena, len);
+    if (copy != NULL)
+        memcpy(copy, s, len);
+
+    return copy;
+}
+/*---------------------------------------------------------------------------*/
+void arena_reset(Arena_T oArena) {
+    assert(oArena != NULL);
+
+    oArena->cur = oArena->head;
+    oArena->head->used = 0;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,44 @@
+/*---------------------------------------------------------------------------*/
+/* arena.h                                                                   */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+
+/* An Arena hands out memory by bumping a pointer through a list of
+   large chunks.  Nothing is freed individually; arena_reset() releases
+   everything at once in constant time and keeps the chunks for reuse.
+
+   The shell keeps one Arena per input line: tokens, their strings,
+   argument vectors and command descriptions are carved from it, and
+   it is reset after the line has run. */
+typedef struct Arena *Arena_T;
+
+
+/* Return a new, empty Arena, or NULL if insufficient memory is
+   available. */
+Arena_T arena_new(void);
+
+
+/* Free oArena and every chunk it owns. */
+void arena_free(Arena_T oArena);
+
+
+/* Return size bytes of suitably aligned memory from oArena, or NULL if
+   insufficient memory is available.  The memory stays valid until the
+   next arena_reset(). */
+void *arena_alloc(Arena_T oArena, size_t size);
+
+
+/* Return a copy of string s allocated from oArena, or NULL if
+   insufficient memory is available. */
+char *arena_strdup(Arena_T oArena, const char *s);
+
+
+/* Release everything allocated from oArena. */
+void arena_reset(Arena_T oArena);
+
+#endif /* _ARENA_H_ */
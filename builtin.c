@@ -0,0 +1,683 @@
+/*---------------------------------------------------------------------------*/
+/* builtin.c                                                                 */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "builtin.h"
+#include "fdreg.h"
+#include "parallel.h"
+
+static int echo_main(int argc, char *argv[]);
+static int true_main(int argc, char *argv[]);
+static int false_main(int argc, char *argv[]);
+static int pwd_main(int argc, char *argv[]);
+static int printf_main(int argc, char *argv[]);
+static int test_main(int argc, char *argv[]);
+
+/* HASH() places every name in its own slot.  Adding a builtin means
+   finding a new multiplier or table size under which it collides with
+   none of the others, and moving every entry to its new slot. */
+enum {TABLE_SIZE = 64};
+#define HASH(s, len) \
+    (((unsigned char)(s)[0] + 6u * (unsigned char)(s)[(len) - 1]) % \
+     TABLE_SIZE)
+
+static const struct Builtin table[TABLE_SIZE] = {
+    [4]  = {"false",    NORMAL,  false_main},
+    [8]  = {"pwd",      NORMAL,  pwd_main},
+    [18] = {"true",     NORMAL,  true_main},
+    [20] = {"printf",   NORMAL,  printf_main},
+    [24] = {"hash",     B_HASH,  NULL},
+    [28] = {"jobs",     B_JOBS,  NULL},
+    [29] = {"exit",     B_EXIT,  NULL},
+    [37] = {"stats",    B_STATS, NULL},
+    [43] = {"set",      B_SET,   NULL},
+    [44] = {"test",     NORMAL,  test_main},
+    [56] = {"parallel", NORMAL,  parallel_main},
+    [59] = {"cd",       B_CD,    NULL},
+    [61] = {"[",        NORMAL,  test_main},
+    [63] = {"echo",     NORMAL,  echo_main},
+};
+
+/*---------------------------------------------------------------------------*/
+const struct Builtin *builtin_find(const char *name) {
+    size_t len = strlen(name);
+    const struct Builtin *b;
+
+    if (len == 0)
+        return NULL;
+
+    b = &table[HASH(name, len)];
+    if (b->name == NULL || strcmp(b->name, name) != 0)
+        return NULL;
+
+    return b;
+}
+/*---------------------------------------------------------------------------*/
+/* Report a failure of the builtin called name */
+static void builtin_error(const char *name, const char *what,
+                          const char *detail) {
+    char msg[256];
+
+    if (detail != NULL)
+        snprintf(msg, sizeof(msg), "%s: %s: %s", name, what, detail);
+    else
+        snprintf(msg, sizeof(msg), "%s: %s", name, what);
+    error_print(msg, FPRINTF);
+}
+/*---------------------------------------------------------------------------*/
+/* Flush stdout; return status, or EXIT_FAILURE if output was lost. */
+static int flush_output(const char *name, int status) {
+    if (fflush(stdout) != 0 || ferror(stdout)) {
+        builtin_error(name, "write error", strerror(errno));
+        clearerr(stdout);
+        return EXIT_FAILURE;
+    }
+
+    return status;
+}
+/*---------------------------------------------------------------------------*/
+/* Make fname, opened with flags, the descriptor target, first saving
+   target in *saved.  Return 0, or -1 after reporting the error. */
+static int redirect(const char *fname, int flags, int target, int *saved) {
+    int fd;
+
+    *saved = fcntl(target, F_DUPFD_CLOEXEC, 10);
+    if (*saved < 0 && errno != EBADF) {
+        error_print(NULL, PERROR);
+        return -1;
+    }
+    if (*saved >= 0 && fdreg_add(*saved) < 0) {
+        *saved = -1;
+        error_print(NULL, PERROR);
+        return -1;
+    }
+
+    fd = fdreg_open(fname, flags, 0644);
+    if (fd < 0) {
+        error_print(NULL, PERROR);
+        return -1;
+    }
+    dup2(fd, target);
+    fdreg_close(fd);
+
+    return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Undo redirect(): a target that was closed before is closed again */
+static void restore(int target, int saved) {
+    if (saved >= 0) {
+        dup2(saved, target);
+        fdreg_close(saved);
+    }
+    else
+        close(target);
+}
+/*---------------------------------------------------------------------------*/
+int builtin_run(const struct CommandInfo *cmd) {
+    int saved_in = -1, saved_out = -1, status = EXIT_FAILURE;
+
+    /* Output the shell buffered belongs where stdout is now */
+    fflush(stdout);
+
+    if (cmd->redirect_in != NULL &&
+        redirect(cmd->redirect_in, O_RDONLY, STDIN_FILENO, &saved_in) < 0)
+        goto out;
+    if (cmd->redirect_out != NULL &&
+        redirect(cmd->redirect_out, O_WRONLY | O_CREAT | O_TRUNC,
+                 STDOUT_FILENO, &saved_out) < 0)
+        goto out;
+
+    status = flush_output(cmd->args[0], cmd->builtin(cmd->cnt, cmd->args));
+
+out:
+    if (cmd->redirect_out != NULL)
+        restore(STDOUT_FILENO, saved_out);
+    if (cmd->redirect_in != NULL)
+        restore(STDIN_FILENO, saved_in);
+
+    return status;
+}
+/*---------------------------------------------------------------------------*/
+void builtin_exit(const struct CommandInfo *cmd) {
+    int status = cmd->builtin(cmd->cnt, cmd->args);
+
+    /* _exit() keeps the shell's atexit() cleanup from running here */
+    _exit(flush_output(cmd->args[0], status));
+}
+/*---------------------------------------------------------------------------*/
+/* Output the escape sequence s starts with (s follows a backslash) and
+   return how many characters of s it takes up.  An octal escape is
+   \0nnn for echo and \nnn for printf.  Set *stop for \c. */
+static int put_escape(const char *s, int echo_octal, int *stop) {
+    static const char from[] = "\\abefnrtv", to[] = "\\\a\b\033\f\n\r\t\v";
+    const char *p;
+    int i = 0, c = 0, digit;
+
+    if (*s != '\0' && (p = strchr(from, *s)) != NULL) {
+        putchar(to[p - from]);
+        return 1;
+    }
+
+    switch (*s) {
+    case 'c':
+        *stop = 1;
+        return 1;
+
+    case 'x':
+        for (i = 1; i <= 2; i++) {
+            if (s[i] >= '0' && s[i] <= '9')
+                digit = s[i] - '0';
+            else if (s[i] >= 'a' && s[i] <= 'f')
+                digit = s[i] - 'a' + 10;
+            else if (s[i] >= 'A' && s[i] <= 'F')
+                digit = s[i] - 'A' + 10;
+            else
+                break;
+            c = c * 16 + digit;
+        }
+        if (i == 1)
+            break;
+        putchar(c);
+        return i;
+
+    case '0': case '1': case '2': case '3':
+    case '4': case '5': case '6': case '7':
+        if (echo_octal && *s != '0')
+            break;
+        if (echo_octal)
+            i = 1;
+        for (; i < (echo_octal ? 4 : 3) && s[i] >= '0' && s[i] <= '7'; i++)
+            c = c * 8 + s[i] - '0';
+        putchar(c);
+        return i;
+    }
+
+    /* Not an escape: the backslash stands for itself */
+    putchar('\\');
+    return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Output s with its escapes interpreted; return nonzero after \c. */
+static int put_escaped(const char *s, int echo_octal) {
+    int stop = 0;
+
+    for (; *s != '\0' && !stop; s++) {
+        if (*s == '\\')
+            s += put_escape(s + 1, echo_octal, &stop);
+        else
+            putchar(*s);
+    }
+
+    return stop;
+}
+/*---------------------------------------------------------------------------*/
+static int echo_main(int argc, char *argv[]) {
+    int i = 1, newline = 1, escapes = 0;
+    const char *p;
+
+    /* As with /bin/echo, an argument is options only if every letter
+       after the '-' is one */
+    for (; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+        for (p = argv[i] + 1; *p != '\0' && strchr("neE", *p) != NULL; p++)
+            ;
+        if (*p != '\0')
+            break;
+        for (p = argv[i] + 1; *p != '\0'; p++) {
+            if (*p == 'n')
+                newline = 0;
+            else
+                escapes = (*p == 'e');
+        }
+    }
+
+    for (; i < argc; i++) {
+        if (escapes) {
+            if (put_escaped(argv[i], 1))
+                return EXIT_SUCCESS;
+        }
+        else
+            fputs(argv[i], stdout);
+        if (i < argc - 1)
+            putchar(' ');
+    }
+    if (newline)
+        putchar('\n');
+
+    return EXIT_SUCCESS;
+}
+/*---------------------------------------------------------------------------*/
+static int true_main(int argc, char *argv[]) {
+    return EXIT_SUCCESS;
+}
+/*---------------------------------------------------------------------------*/
+static int false_main(int argc, char *argv[]) {
+    return EXIT_FAILURE;
+}
+/*---------------------------------------------------------------------------*/
+static int pwd_main(int argc, char *argv[]) {
+    char *cwd = getcwd(NULL, 0);
+
+    if (cwd == NULL) {
+        builtin_error("pwd", strerror(errno), NULL);
+        return EXIT_FAILURE;
+    }
+    puts(cwd);
+    free(cwd);
+
+    return EXIT_SUCCESS;
+}
+/*---------------------------------------------------------------------------*/
+/* Convert a printf argument to a number as printf(1) does: a leading
+   quote gives the value of the next character.  Set *status to
+   EXIT_FAILURE if arg is not a number. */
+static long long printf_number(const char *arg, int *status) {
+    char *end;
+    long long n;
+
+    if (arg[0] == '\'' || arg[0] == '\"')
+        return (unsigned char)arg[1];
+
+    errno = 0;
+    n = strtoll(arg, &end, 0);
+    if (end == arg || *end != '\0' || errno != 0) {
+        builtin_error("printf", arg, end == arg ? "expected a numeric value"
+                      : errno != 0 ? strerror(errno)
+                      : "value not completely converted");
+        *status = EXIT_FAILURE;
+    }
+
+    return n;
+}
+/*---------------------------------------------------------------------------*/
+static double printf_double(const char *arg, int *status) {
+    char *end;
+    double d;
+
+    if (arg[0] == '\'' || arg[0] == '\"')
+        return (unsigned char)arg[1];
+
+    d = strtod(arg, &end);
+    if (end == arg || *end != '\0') {
+        builtin_error("printf", arg, "expected a numeric value");
+        *status = EXIT_FAILURE;
+    }
+
+    return d;
+}
+/*---------------------------------------------------------------------------*/
+/* Take a "*" width or precision, called what, from the next argument */
+static int printf_star(const char *what, int argc, char *argv[], int *next,
+                       int *status) {
+    const char *arg = *next < argc ? argv[(*next)++] : NULL;
+    long long n;
+
+    if (arg == NULL)
+        return 0;
+    n = printf_number(arg, status);
+    if (n < INT_MIN || n > INT_MAX) {
+        builtin_error("printf", what, arg);
+        *status = EXIT_FAILURE;
+        return 0;
+    }
+
+    return n;
+}
+/*---------------------------------------------------------------------------*/
+/* Output format once, taking conversions from argv starting at *next.
+   Return nonzero if \c or %b's \c ended all output. */
+static int printf_once(const char *format, int argc, char *argv[],
+                       int *next, int *status) {
+    char spec[64], *s;
+    const char *f, *start, *arg;
+    int len, prec, stop = 0;
+
+    for (f = format; *f != '\0' && !stop; f++) {
+        if (*f == '\\') {
+            f += put_escape(f + 1, 0, &stop);
+            continue;
+        }
+        if (*f != '%') {
+            putchar(*f);
+            continue;
+        }
+        if (f[1] == '%') {
+            putchar('%');
+            f++;
+            continue;
+        }
+
+        /* Copy "%[flags][width][.precision]" into spec, taking a "*"
+           width or precision from the next argument, and find the
+           conversion.  Each part is kept short enough for spec. */
+        start = f++;
+        spec[0] = '%';
+        s = spec + 1;
+        len = strspn(f, "-+ #0");
+        if (len > 12)
+            len = -1;
+        else {
+            memcpy(s, f, len);
+            s += len;
+            f += len;
+        }
+        if (len >= 0 && *f == '*') {
+            s += sprintf(s, "%d", printf_star("invalid field width", argc,
+                                              argv, next, status));
+            f++;
+        }
+        else if (len >= 0 && (len = strspn(f, "0123456789")) <= 12) {
+            memcpy(s, f, len);
+            s += len;
+            f += len;
+        }
+        else
+            len = -1;
+        if (len >= 0 && *f == '.' && f[1] == '*') {
+            /* A negative precision is taken as none */
+            prec = printf_star("invalid precision", argc, argv, next,
+                               status);
+            if (prec >= 0)
+                s += sprintf(s, ".%d", prec);
+            f += 2;
+        }
+        else if (len >= 0 && *f == '.' &&
+                 (len = strspn(f + 1, "0123456789")) <= 12) {
+            memcpy(s, f, len + 1);
+            s += len + 1;
+            f += len + 1;
+        }
+        else if (*f == '.')
+            len = -1;
+        if (len < 0 || *f == '\0' ||
+            strchr("diouxXcsbfFeEgGaA", *f) == NULL) {
+            builtin_error("printf", "invalid conversion", start);
+            *status = EXIT_FAILURE;
+            return 1;
+        }
+
+        arg = *next < argc ? argv[(*next)++] : NULL;
+        switch (*f) {
+        case 'd': case 'i':
+            strcpy(s, "lld");
+            s[2] = *f;
+            printf(spec, arg == NULL ? 0 : printf_number(arg, status));
+            break;
+        case 'o': case 'u': case 'x': case 'X':
+            strcpy(s, "ll?");
+            s[2] = *f;
+            printf(spec, (unsigned long long)
+                   (arg == NULL ? 0 : printf_number(arg, status)));
+            break;
+        case 'f': case 'F': case 'e': case 'E':
+        case 'g': case 'G': case 'a': case 'A':
+            s[0] = *f;
+            s[1] = '\0';
+            printf(spec, arg == NULL ? 0.0 : printf_double(arg, status));
+            break;
+        case 'c':
+            strcpy(s, "c");
+            if (arg != NULL && arg[0] != '\0')
+                printf(spec, arg[0]);
+            break;
+        case 's':
+            strcpy(s, "s");
+            printf(spec, arg == NULL ? "" : arg);
+            break;
+        case 'b':
+            /* Width and precision are not applied to %b */
+            stop = put_escaped(arg == NULL ? "" : arg, 1);
+            break;
+        }
+    }
+
+    return stop;
+}
+/*---------------------------------------------------------------------------*/
+static int printf_main(int argc, char *argv[]) {
+    int next = 2, status = EXIT_SUCCESS, used;
+
+    if (argc < 2) {
+        builtin_error("printf", "missing operand", NULL);
+        return EXIT_FAILURE;
+    }
+
+    /* The format is reused as long as it uses up arguments */
+    do {
+        used = next;
+        if (printf_once(argv[1], argc, argv, &next, &status))
+            break;
+    } while (next < argc && next > used);
+
+    return status;
+}
+/*---------------------------------------------------------------------------*/
+/* State of one test(1) evaluation */
+struct TestArgs {
+    char **argv;
+    int argc;
+    int pos;
+    int error;
+};
+
+static int test_or(struct TestArgs *t);
+
+/*---------------------------------------------------------------------------*/
+static void test_error(struct TestArgs *t, const char *what,
+                       const char *detail) {
+    if (!t->error)
+        builtin_error(t->argv[0], what, detail);
+    t->error = 1;
+}
+/*---------------------------------------------------------------------------*/
+static int is_binary_op(const char *s) {
+    static const char *const ops[] = {
+        "=", "==", "!=", "<", ">", "-eq", "-ne", "-lt", "-le", "-gt",
+        "-ge", "-nt", "-ot", "-ef", NULL
+    };
+    int i;
+
+    for (i = 0; ops[i] != NULL; i++)
+        if (strcmp(s, ops[i]) == 0)
+            return 1;
+
+    return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int is_unary_op(const char *s) {
+    return s[0] == '-' && s[1] != '\0' && s[2] == '\0' &&
+        strchr("bcdefghknprstuwxzLOGS", s[1]) != NULL;
+}
+/*---------------------------------------------------------------------------*/
+static long long test_integer(struct TestArgs *t, const char *s) {
+    char *end;
+    long long n;
+
+    errno = 0;
+    n = strtoll(s, &end, 10);
+    while (*end == ' ' || *end == '\t')
+        end++;
+    if (end == s || *end != '\0' || errno != 0)
+        test_error(t, "integer expression expected", s);
+
+    return n;
+}
+/*---------------------------------------------------------------------------*/
+static int test_unary(struct TestArgs *t, char op, const char *arg) {
+    struct stat st;
+
+    switch (op) {
+    case 'n': return arg[0] != '\0';
+    case 'z': return arg[0] == '\0';
+    case 't': return isatty((int)test_integer(t, arg));
+    case 'r': return access(arg, R_OK) == 0;
+    case 'w': return access(arg, W_OK) == 0;
+    case 'x': return access(arg, X_OK) == 0;
+    case 'h':
+    case 'L': return lstat(arg, &st) == 0 && S_ISLNK(st.st_mode);
+    }
+
+    if (stat(arg, &st) < 0)
+        return 0;
+
+    switch (op) {
+    case 'b': return S_ISBLK(st.st_mode);
+    case 'c': return S_ISCHR(st.st_mode);
+    case 'd': return S_ISDIR(st.st_mode);
+    case 'f': return S_ISREG(st.st_mode);
+    case 'p': return S_ISFIFO(st.st_mode);
+    case 'S': return S_ISSOCK(st.st_mode);
+    case 's': return st.st_size > 0;
+    case 'g': return (st.st_mode & S_ISGID) != 0;
+    case 'u': return (st.st_mode & S_ISUID) != 0;
+    case 'k': return (st.st_mode & S_ISVTX) != 0;
+    case 'O': return st.st_uid == geteuid();
+    case 'G': return st.st_gid == getegid();
+    default:  return 1;  /* -e */
+    }
+}
+/*---------------------------------------------------------------------------*/
+static int test_binary(struct TestArgs *t, const char *a, const char *op,
+                       const char *b) {
+    struct stat sa, sb;
+    long long x, y;
+
+    if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0)
+        return strcmp(a, b) == 0;
+    if (strcmp(op, "!=") == 0)
+        return strcmp(a, b) != 0;
+    if (strcmp(op, "<") == 0)
+        return strcmp(a, b) < 0;
+    if (strcmp(op, ">") == 0)
+        return strcmp(a, b) > 0;
+
+    if (strcmp(op, "-ef") == 0)
+        return stat(a, &sa) == 0 && stat(b, &sb) == 0 &&
+            sa.st_dev == sb.st_dev && sa.st_ino == sb.st_ino;
+    if (strcmp(op, "-ot") == 0)
+        return test_binary(t, b, "-nt", a);
+    if (strcmp(op, "-nt") == 0) {
+        /* A file that exists is newer than one that does not */
+        if (stat(a, &sa) < 0)
+            return 0;
+        if (stat(b, &sb) < 0)
+            return 1;
+        return sa.st_mtim.tv_sec > sb.st_mtim.tv_sec ||
+            (sa.st_mtim.tv_sec == sb.st_mtim.tv_sec &&
+             sa.st_mtim.tv_nsec > sb.st_mtim.tv_nsec);
+    }
+
+    x = test_integer(t, a);
+    y = test_integer(t, b);
+
+    if (strcmp(op, "-eq") == 0) return x == y;
+    if (strcmp(op, "-ne") == 0) return x != y;
+    if (strcmp(op, "-lt") == 0) return x < y;
+    if (strcmp(op, "-le") == 0) return x <= y;
+    if (strcmp(op, "-gt") == 0) return x > y;
+    return x >= y;  /* -ge */
+}
+/*---------------------------------------------------------------------------*/
+static int test_primary(struct TestArgs *t) {
+    char **argv = t->argv + t->pos;
+    int left = t->argc - t->pos, v;
+
+    if (left <= 0) {
+        test_error(t, "argument expected", NULL);
+        return 0;
+    }
+
+    /* A binary operator wins, so "test ( = (" compares strings */
+    if (left >= 3 && is_binary_op(argv[1])) {
+        t->pos += 3;
+        return test_binary(t, argv[0], argv[1], argv[2]);
+    }
+
+    if (strcmp(argv[0], "(") == 0 && left >= 2) {
+        t->pos++;
+        v = test_or(t);
+        if (t->pos >= t->argc || strcmp(t->argv[t->pos], ")") != 0)
+            test_error(t, "')' expected", NULL);
+        else
+            t->pos++;
+        return v;
+    }
+
+    if (left >= 2 && is_unary_op(argv[0])) {
+        t->pos += 2;
+        return test_unary(t, argv[0][1], argv[1]);
+    }
+
+    t->pos++;
+    return argv[0][0] != '\0';
+}
+/*---------------------------------------------------------------------------*/
+static int test_not(struct TestArgs *t) {
+    int left = t->argc - t->pos;
+
+    /* "test ! = x" compares "!" with "x" */
+    if (left >= 2 && strcmp(t->argv[t->pos], "!") == 0 &&
+        !(left >= 3 && is_binary_op(t->argv[t->pos + 1]))) {
+        t->pos++;
+        return !test_not(t);
+    }
+
+    return test_primary(t);
+}
+/*---------------------------------------------------------------------------*/
+static int test_and(struct TestArgs *t) {
+    int v = test_not(t);
+
+    while (t->pos < t->argc && strcmp(t->argv[t->pos], "-a") == 0) {
+        t->pos++;
+        v = test_not(t) && v;
+    }
+
+    return v;
+}
+/*---------------------------------------------------------------------------*/
+static int test_or(struct TestArgs *t) {
+    int v = test_and(t);
+
+    while (t->pos < t->argc && strcmp(t->argv[t->pos], "-o") == 0) {
+        t->pos++;
+        v = test_and(t) || v;
+    }
+
+    return v;
+}
+/*---------------------------------------------------------------------------*/
+/* test and [: exit with 0 if the expression is true, 1 if it is false
+   and 2 if it is malformed */
+static int test_main(int argc, char *argv[]) {
+    struct TestArgs t = {argv, argc, 1, 0};
+    int v;
+
+    if (strcmp(argv[0], "[") == 0) {
+        if (strcmp(argv[argc - 1], "]") != 0) {
+            builtin_error("[", "missing ']'", NULL);
+            return 2;
+        }
+        t.argc--;
+    }
+
+    /* No expression is false */
+    if (t.argc == 1)
+        return EXIT_FAILURE;
+
+    v = test_or(&t);
+    if (t.pos < t.argc)
+        test_error(&t, "extra argument", t.argv[t.pos]);
+
+    return t.error ? 2 : !v;
+}
+/*---------------------------------------------------------------------------*/
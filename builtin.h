@@ -0,0 +1,46 @@
+/*---------------------------------------------------------------------------*/
+/* builtin.h                                                                 */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#ifndef _BUILTIN_H_
+#define _BUILTIN_H_
+
+#include "util.h"
+#include "plan.h"
+
+/* Every name the shell implements itself is in one table, found with
+   a perfect hash: one hash computation and one strcmp() per lookup.
+
+   Builtins that change the shell (cd, exit, hash, jobs, set, stats)
+   have a BuiltinType and are run from their tokens by
+   execute_builtin().  The others (echo, true, false, pwd, printf,
+   test, [ and parallel, see parallel.h) only need their arguments,
+   stdin and stdout, so they are compiled into a Plan like any command
+   and carry a BuiltinFn instead of a path.  A foreground simple
+   command runs its BuiltinFn in the shell, with its redirections
+   applied to the shell's own stdin and stdout and undone afterwards;
+   a pipeline stage or a background job runs it in a forked child that
+   never calls exec. */
+
+typedef int (*BuiltinFn)(int argc, char *argv[]);
+
+struct Builtin {
+    const char *name;
+    enum BuiltinType type;  /* NORMAL for those run through a Plan */
+    BuiltinFn fn;           /* NULL for those with a BuiltinType */
+};
+
+/* Return the builtin called name, or NULL if there is none. */
+const struct Builtin *builtin_find(const char *name);
+
+/* Run cmd, whose builtin must be set, in the shell: apply its
+   redirections, call the builtin, flush stdout and put stdin and
+   stdout back.  Return the exit status. */
+int builtin_run(const struct CommandInfo *cmd);
+
+/* Run cmd, whose builtin must be set, in a child whose stdin, stdout
+   and redirections are already in place, and exit with its status. */
+void builtin_exit(const struct CommandInfo *cmd);
+
+#endif /* _BUILTIN_H_ */
@@ -0,0 +1,292 @@
+/*---------------------------------------------------------------------------*/
+/* cmdhash.c                                                                 */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "cmdhash.h"
+#include "util.h"
+
+enum {MIN_BUCKETS = 64};
+
+struct CmdEntry {
+    /* Command name as typed, e.g. "ls" */
+    char *name;
+
+    /* Absolute path to execute, NULL for a negative entry */
+    char *path;
+
+    /* CLOCK_MONOTONIC second at which a negative entry expires */
+    time_t expires;
+
+    unsigned int hash;
+    int hits;
+    struct CmdEntry *next;
+};
+
+static struct CmdEntry **buckets;
+static int bucket_cnt;
+static int entry_cnt;
+
+/* The PATH value the table was filled under */
+static char *hashed_path;
+
+/*---------------------------------------------------------------------------*/
+static unsigned int hash_name(const char *name) {
+    unsigned int h = 2166136261u;
+
+    /* FNV-1a */
+    while (*name != '\0') {
+        h ^= (unsigned char)*name++;
+        h *= 16777619u;
+    }
+
+    return h;
+}
+/*---------------------------------------------------------------------------*/
+static time_t now_sec(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+/*---------------------------------------------------------------------------*/
+static const char *current_path(void) {
+    const char *path = getenv("PATH");
+
+    /* Same default execvp() uses */
+    return path != NULL ? path : "/bin:/usr/bin";
+}
+/*---------------------------------------------------------------------------*/
+static void free_entry(struct CmdEntry *e) {
+    free(e->name);
+    free(e->path);
+    free(e);
+}
+/*---------------------------------------------------------------------------*/
+void cmdhash_clear(void) {
+    int i;
+    struct CmdEntry *e, *next;
+
+    for (i = 0; i < bucket_cnt; i++) {
+        for (e = buckets[i]; e != NULL; e = next) {
+            next = e->next;
+            free_entry(e);
+        }
+        buckets[i] = NULL;
+    }
+    entry_cnt = 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Drop the table if PATH no longer matches the one it was built for. */
+static void check_path_changed(void) {
+    const char *path = current_path();
+
+    if (hashed_path != NULL && strcmp(hashed_path, path) == 0)
+        return;
+
+    cmdhash_clear();
+    free(hashed_path);
+    hashed_path = strdup(path);
+}
+/*---------------------------------------------------------------------------*/
+/* Double the number of buckets once the table is fully loaded. */
+static void grow_table(void) {
+    int i, new_cnt = bucket_cnt ? bucket_cnt * 2 : MIN_BUCKETS;
+    struct CmdEntry **new_buckets, *e, *next;
+
+    new_buckets = calloc(new_cnt, sizeof(struct CmdEntry *));
+    if (new_buckets == NULL)
+        return;
+
+    for (i = 0; i < bucket_cnt; i++) {
+        for (e = buckets[i]; e != NULL; e = next) {
+            next = e->next;
+            e->next = new_buckets[e->hash & (new_cnt - 1)];
+            new_buckets[e->hash & (new_cnt - 1)] = e;
+        }
+    }
+
+    free(buckets);
+    buckets = new_buckets;
+    bucket_cnt = new_cnt;
+}
+/*---------------------------------------------------------------------------*/
+static struct CmdEntry **find_slot(const char *name, unsigned int h) {
+    struct CmdEntry **pe;
+
+    for (pe = &buckets[h & (bucket_cnt - 1)]; *pe != NULL;
+         pe = &(*pe)->next) {
+        if ((*pe)->hash == h && strcmp((*pe)->name, name) == 0)
+            break;
+    }
+
+    return pe;
+}
+/*---------------------------------------------------------------------------*/
+/* Walk PATH the way execvp() does.  Return a malloc'ed path or NULL
+   with errno set.  *cacheable is cleared if the answer depends on the
+   current directory (a relative or empty PATH element). */
+static char *search_path(const char *name, int *cacheable) {
+    const char *dir = current_path(), *end;
+    char buf[PATH_MAX];
+    struct stat st;
+    int len, err = ENOENT;
+
+    *cacheable = TRUE;
+
+    for (;;) {
+        end = strchrnul(dir, ':');
+        len = end - dir;
+
+        if (len == 0 || dir[0] != '/')
+            *cacheable = FALSE;
+
+        if (len == 0)
+            len = snprintf(buf, sizeof(buf), "./%s", name);
+        else
+            len = snprintf(buf, sizeof(buf), "%.*s/%s", len, dir, name);
+
+        if (len < (int)sizeof(buf) && stat(buf, &st) == 0 &&
+            S_ISREG(st.st_mode)) {
+            if (access(buf, X_OK) == 0) {
+                if (dir[0] != '/')
+                    *cacheable = FALSE;
+                return strdup(buf);
+            }
+            err = EACCES;
+        }
+
+        if (*end == '\0')
+            break;
+        dir = end + 1;
+    }
+
+    /* A file that exists but cannot be run may become runnable */
+    if (err == EACCES)
+        *cacheable = FALSE;
+
+    errno = err;
+    return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Hand out a path that is not kept in the table.  The caller uses it
+   for the command being started only, so keeping the latest one alive
+   is enough. */
+static const char *keep_uncached(char *path) {
+    static char *uncached;
+    int err = errno;
+
+    free(uncached);
+    uncached = path;
+    errno = err;
+    return path;
+}
+/*---------------------------------------------------------------------------*/
+const char *cmdhash_lookup(const char *name) {
+    struct CmdEntry **pe, *e;
+    unsigned int h;
+    char *path;
+    int cacheable, err;
+
+    if (strchr(name, '/') != NULL)
+        return name;
+
+    check_path_changed();
+    if (bucket_cnt == 0)
+        grow_table();
+    if (bucket_cnt == 0)
+        return keep_uncached(search_path(name, &cacheable));
+
+    h = hash_name(name);
+    pe = find_slot(name, h);
+    e = *pe;
+
+    if (e != NULL) {
+        if (e->path != NULL) {
+            e->hits++;
+            return e->path;
+        }
+        if (now_sec() < e->expires) {
+            e->hits++;
+            errno = ENOENT;
+            return NULL;
+        }
+
+        /* Expired negative entry: search again */
+        *pe = e->next;
+        free_entry(e);
+        entry_cnt--;
+    }
+
+    path = search_path(name, &cacheable);
+    if (!cacheable)
+        return keep_uncached(path);
+    err = errno;
+
+    e = calloc(1, sizeof(struct CmdEntry));
+    if (e == NULL || (e->name = strdup(name)) == NULL) {
+        free(e);
+        free(path);
+        errno = ENOMEM;
+        return NULL;
+    }
+    e->path = path;
+    e->hash = h;
+    e->hits = 1;
+    if (path == NULL)
+        e->expires = now_sec() + NEGATIVE_TTL;
+
+    if (entry_cnt >= bucket_cnt)
+        grow_table();
+    pe = &buckets[h & (bucket_cnt - 1)];
+    e->next = *pe;
+    *pe = e;
+    entry_cnt++;
+
+    errno = err;
+    return path;
+}
+/*---------------------------------------------------------------------------*/
+void cmdhash_forget(const char *name) {
+    struct CmdEntry **pe, *e;
+
+    if (bucket_cnt == 0 || strchr(name, '/') != NULL)
+        return;
+
+    pe = find_slot(name, hash_name(name));
+    if ((e = *pe) != NULL) {
+        *pe = e->next;
+        free_entry(e);
+        entry_cnt--;
+    }
+}
+/*---------------------------------------------------------------------------*/
+void cmdhash_print(void) {
+    int i;
+    struct CmdEntry *e;
+
+    if (entry_cnt == 0) {
+        printf("hash: hash table empty\n");
+        return;
+    }
+
+    printf("hits\tcommand\n");
+    for (i = 0; i < bucket_cnt; i++) {
+        for (e = buckets[i]; e != NULL; e = e->next) {
+            if (e->path != NULL)
+                printf("%4d\t%s\n", e->hits, e->path);
+            else
+                printf("%4d\t%s (not found)\n", e->hits, e->name);
+        }
+    }
+}
+/*---------------------------------------------------------------------------*/
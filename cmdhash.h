@@ -0,0 +1,35 @@
+/*---------------------------------------------------------------------------*/
+/* cmdhash.h                                                                 */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#ifndef _CMDHASH_H_
+#define _CMDHASH_H_
+
+/* The shell remembers where each command name was found in PATH, so a
+   command is searched for once instead of once per execution.  Names
+   that were not found are remembered too (negative entries) for
+   NEGATIVE_TTL seconds.  The whole table is dropped whenever PATH
+   changes. */
+
+enum {NEGATIVE_TTL = 2};
+
+/* Return the executable file to run for command name.  A name that
+   contains a slash is returned unchanged.  Otherwise PATH is searched
+   (or the table consulted) and the absolute path is returned; the
+   string is owned by the table and stays valid until the entry is
+   forgotten.  Return NULL and set errno (ENOENT or EACCES) if name
+   cannot be executed. */
+const char *cmdhash_lookup(const char *name);
+
+/* Forget what is known about name, e.g. because executing the
+   remembered path failed with ENOENT. */
+void cmdhash_forget(const char *name);
+
+/* Forget every remembered command. */
+void cmdhash_clear(void);
+
+/* Write the remembered commands and their hit counts to stdout. */
+void cmdhash_print(void);
+
+#endif /* _CMDHASH_H_ */
@@ -0,0 +1,238 @@
+/*---------------------------------------------------------------------------*/
+/* evloop.c                                                                  */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/pidfd.h>
+#include <sys/wait.h>
+
+#include "evloop.h"
+#include "reap.h"
+#include "jobs.h"
+#include "fdreg.h"
+#include "rusage.h"
+#include "trace.h"
+
+enum {MAX_EVENTS = 64};
+
+/* Children beyond this many are left to the SIGCHLD sweep, so a long
+   pipeline or many background jobs don't hold a descriptor each */
+enum {MAX_PIDFDS = 256};
+
+/* children_fd watches the signalfd and the pidfds; loop_fd watches
+   the input and children_fd, so a foreground wait can ignore input
+   without touching the input's registration. */
+static int children_fd = -1;
+static int loop_fd = -1;
+static int signal_fd = -1;
+
+/* -1 when there is no input to poll */
+static int input_fd = -1;
+
+/* Some child has no pidfd, so SIGCHLD triggers a wait4() sweep */
+static int sweep;
+static int pidfd_cnt;
+
+/* The shell.  A forked child shares the loop's descriptors with it,
+   so it must not use them. */
+static pid_t loop_pid;
+
+/*---------------------------------------------------------------------------*/
+static int watch_fd(int epfd, int fd) {
+    struct epoll_event ev;
+
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+
+    return epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+/*---------------------------------------------------------------------------*/
+int evloop_init(int fd) {
+    sigset_t mask;
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+
+    loop_pid = getpid();
+    signal_fd = fdreg_add(signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC));
+    children_fd = fdreg_add(epoll_create1(EPOLL_CLOEXEC));
+    loop_fd = fdreg_add(epoll_create1(EPOLL_CLOEXEC));
+    if (signal_fd < 0 || children_fd < 0 || loop_fd < 0)
+        return -1;
+
+    if (watch_fd(children_fd, signal_fd) < 0 ||
+        watch_fd(loop_fd, children_fd) < 0)
+        return -1;
+
+    /* epoll refuses regular files, which are always readable anyway */
+    if (fd >= 0) {
+        if (watch_fd(loop_fd, fd) == 0)
+            input_fd = fd;
+        else if (errno != EPERM)
+            return -1;
+    }
+
+    return 0;
+}
+/*---------------------------------------------------------------------------*/
+void evloop_watch(pid_t pid) {
+    int fd;
+
+    if (getpid() != loop_pid)
+        return;
+
+    if (pidfd_cnt < MAX_PIDFDS) {
+        /* pidfds are always close-on-exec */
+        fd = fdreg_add(pidfd_open(pid, 0));
+        if (fd >= 0) {
+            if (watch_fd(children_fd, fd) == 0) {
+                pidfd_cnt++;
+                return;
+            }
+            fdreg_close(fd);
+        }
+    }
+
+    /* Leave this child to the SIGCHLD sweep */
+    sweep = 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Wait up to timeout milliseconds for children to terminate and reap
+   the ones that did into the reap ring. */
+static void reap_ready(int timeout) {
+    struct epoll_event evs[MAX_EVENTS];
+    struct signalfd_siginfo si;
+    int i, n;
+
+    n = epoll_wait(children_fd, evs, MAX_EVENTS, timeout);
+
+    for (i = 0; i < n; i++) {
+        if (evs[i].data.fd == signal_fd) {
+            while (read(signal_fd, &si, sizeof(si)) == sizeof(si))
+                trace_instant("SIGCHLD", si.ssi_pid, 0, NULL);
+            if (sweep)
+                reap_children();
+        }
+        else if (reap_pidfd(evs[i].data.fd) != 0) {
+            /* Closing the pidfd also drops it from children_fd */
+            fdreg_close(evs[i].data.fd);
+            pidfd_cnt--;
+        }
+    }
+}
+/*---------------------------------------------------------------------------*/
+/* Hand reaped children to their waiter: the cnt children in pids[],
+   whose statuses go to statuses[] and whose resource usage is added to
+   *usage unless it is NULL, or else the job table.  Return how many of
+   pids[] were reaped. */
+static int dispatch(const pid_t *pids, int cnt, int *statuses,
+                    struct rusage *usage) {
+    struct ReapEvent ev;
+    int i, found = 0;
+
+    while (reap_next(&ev)) {
+        trace_instant("reaped", ev.pid, 0, NULL);
+        for (i = 0; i < cnt; i++)
+            if (pids[i] == ev.pid)
+                break;
+
+        if (i < cnt) {
+            statuses[i] = ev.status;
+            if (usage != NULL)
+                rusage_add(usage, &ev.usage);
+            found++;
+        }
+        else
+            jobs_reap(ev.pid, &ev.usage);
+    }
+
+    return found;
+}
+/*---------------------------------------------------------------------------*/
+enum EvloopResult evloop_wait_input(void) {
+    struct epoll_event evs[2];
+    int i, n, readable;
+
+    for (;;) {
+        readable = (input_fd < 0);
+
+        if (readable)
+            reap_ready(0);
+        else {
+            n = epoll_wait(loop_fd, evs, 2, -1);
+            for (i = 0; i < n; i++) {
+                if (evs[i].data.fd == input_fd)
+                    readable = 1;
+                else
+                    reap_ready(0);
+            }
+        }
+
+        dispatch(NULL, 0, NULL, NULL);
+        if (jobs_finished())
+            return EVLOOP_JOBS;
+        if (readable)
+            return EVLOOP_INPUT;
+    }
+}
+/*---------------------------------------------------------------------------*/
+void evloop_wait_children(const pid_t *pids, int cnt, int *statuses,
+                          struct rusage *usage) {
+    int i, left = 0;
+
+    for (i = 0; i < cnt; i++)
+        if (pids[i] > 0)
+            left++;
+
+    for (;;) {
+        left -= dispatch(pids, cnt, statuses, usage);
+
+        /* Don't hold notices back until the foreground job is done */
+        if (jobs_finished())
+            jobs_report();
+
+        if (left == 0)
+            break;
+        reap_ready(-1);
+    }
+}
+/*---------------------------------------------------------------------------*/
+int evloop_wait_any(const pid_t *pids, int cnt, int *statuses,
+                    struct rusage *usage) {
+    struct rusage ru;
+    int i, status, found;
+    pid_t pid;
+
+    /* Every child of a forked child is one of its own */
+    while (getpid() != loop_pid) {
+        pid = wait4(-1, &status, 0, &ru);
+        if (pid < 0 && errno == EINTR)
+            continue;
+        if (pid < 0)
+            return -1;
+        for (i = 0; i < cnt; i++) {
+            if (pids[i] == pid) {
+                statuses[i] = status;
+                if (usage != NULL)
+                    rusage_add(usage, &ru);
+                return 1;
+            }
+        }
+    }
+
+    for (;;) {
+        found = dispatch(pids, cnt, statuses, usage);
+        if (jobs_finished())
+            jobs_report();
+        if (found > 0)
+            return found;
+        reap_ready(-1);
+    }
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,56 @@
+/*---------------------------------------------------------------------------*/
+/* evloop.h                                                                  */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#ifndef _EVLOOP_H_
+#define _EVLOOP_H_
+
+#include <sys/types.h>
+#include <sys/resource.h>
+
+/* The shell waits for everything in one epoll loop: input becoming
+   readable, a pidfd per child, and a signalfd for SIGCHLD.  SIGCHLD is
+   blocked for good and only read from the signalfd, so there is no
+   signal handler to race with.  Each child is reaped as soon as its
+   pidfd reports it; children that could not get a pidfd, or arrived
+   when a bounded number of pidfds were already open, are swept with
+   wait4() whenever SIGCHLD arrives.  Background children go to
+   the job table (jobs.h) the moment they are reaped. */
+
+enum EvloopResult {
+    EVLOOP_INPUT,   /* Input is readable */
+    EVLOOP_JOBS     /* Background groups finished; see jobs_report() */
+};
+
+/* Set up the loop to watch input_fd, or no input if input_fd is -1.
+   Input that cannot be polled (a regular file) is treated as always
+   readable.  Return 0 on success or -1 with errno set. */
+int evloop_init(int input_fd);
+
+/* Watch child pid until it has been reaped.  Every child the shell
+   starts must be watched.  Called in a forked child, it does nothing. */
+void evloop_watch(pid_t pid);
+
+/* Wait until input is readable or background groups have finished,
+   whichever comes first.  Finished groups are left for the caller to
+   report with jobs_report(). */
+enum EvloopResult evloop_wait_input(void);
+
+/* Wait until each of the cnt children in pids[] has been reaped and
+   store its wait status in statuses[].  Unless usage is NULL, add
+   their resource usage to *usage.  Entries that are not positive are
+   skipped.  Background groups that finish meanwhile are reported right
+   away with jobs_report(). */
+void evloop_wait_children(const pid_t *pids, int cnt, int *statuses,
+                          struct rusage *usage);
+
+/* Like evloop_wait_children(), but return as soon as any of pids[] has
+   been reaped, with the number of them that were; the caller clears
+   their entries before waiting again.  In a forked child of the shell
+   it waits with wait4() for its own children instead.  Return -1 if
+   there is no child left to wait for. */
+int evloop_wait_any(const pid_t *pids, int cnt, int *statuses,
+                    struct rusage *usage);
+
+#endif /* _EVLOOP_H_ */
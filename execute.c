@@ -3,23 +3,35 @@
 /* Author: Jongki Park, Kyoungsoo Park                                       */
 /*---------------------------------------------------------------------------*/
 
-#include "dynarray.h"
 #include "token.h"
 #include "util.h"
 #include "lexsyn.h"
 #include "snush.h"
 #include "execute.h"
+#include "spawn.h"
+#include "cmdhash.h"
+#include "jobs.h"
+#include "evloop.h"
+#include "fdreg.h"
+#include "plancache.h"
+#include "status.h"
+#include "rusage.h"
+#include "stats.h"
+#include "trace.h"
+#include "pipebuf.h"
+#include "builtin.h"
+#include "filter.h"
+#include "optimize.h"
+#include "fanout.h"
 #include <termios.h>
+#include <sys/mman.h>
 
-extern int total_bg_cnt;
-extern struct BgProcessList bg_list;
-extern int total_bg_cnt;
 /*---------------------------------------------------------------------------*/
 void redout_handler(char *fname)
 {
 	int fd;
 
-	fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
 	if (fd < 0)
 	{
 		error_print(NULL, PERROR);
@@ -36,7 +48,7 @@ void redin_handler(char *fname)
 {
 	int fd;
 
-	fd = open(fname, O_RDONLY);
+	fd = open(fname, O_RDONLY | O_CLOEXEC);
 	if (fd < 0)
 	{
 		error_print(NULL, PERROR);
@@ -49,153 +61,196 @@ void redin_handler(char *fname)
 	}
 }
 /*---------------------------------------------------------------------------*/
-
-int build_command_partial(DynArray_T oTokens, int start, int end, struct CommandInfo *cmd)
+/* Replace the calling child process with cmd.  Never returns. */
+static void exec_command(struct CommandInfo *cmd)
 {
-	int i, redout = FALSE, redin = FALSE;
-	struct Token *t;
-
-	cmd->cnt = 0;
-	cmd->redirect_out = NULL;
-	cmd->redirect_in = NULL; // Add this field to CommandInfo struct
-
-	// First pass to count arguments
-	int arg_count = 0;
-	for (i = start; i < end; i++)
-	{
-		t = dynarray_get(oTokens, i);
-		if (t->token_type == TOKEN_WORD)
-		{
-			if (!(redout == TRUE || redin == TRUE))
-			{
-				arg_count++;
-			}
-			redout = FALSE;
-			redin = FALSE;
-		}
-		else if (t->token_type == TOKEN_REDOUT)
-		{
-			redout = TRUE;
-		}
-		else if (t->token_type == TOKEN_REDIN)
-		{
-			redin = TRUE;
-		}
-	}
+	execve(cmd->path, cmd->args, environ);
 
-	// Allocate space for arguments plus NULL terminator
-	cmd->args = malloc(sizeof(char *) * (arg_count + 1));
-	if (cmd->args == NULL)
-	{
-		return -1;
-	}
+	// The remembered location went away; fall back to a PATH walk
+	if (errno == ENOENT && cmd->path != cmd->args[0])
+		execvp(cmd->args[0], cmd->args);
 
-	// Reset flags for second pass
-	redout = FALSE;
-	redin = FALSE;
-
-	// Second pass to fill in arguments
-	for (i = start; i < end; i++)
-	{
-		t = dynarray_get(oTokens, i);
-
-		if (t->token_type == TOKEN_WORD)
-		{
-			if (redout == TRUE)
-			{
-				cmd->redirect_out = t->token_value;
-				redout = FALSE;
-			}
-			else if (redin == TRUE)
-			{
-				cmd->redirect_in = t->token_value;
-				redin = FALSE;
-			}
-			else
-			{
-				cmd->args[cmd->cnt++] = t->token_value;
-			}
-		}
-		else if (t->token_type == TOKEN_REDOUT)
-		{
-			redout = TRUE;
-		}
-		else if (t->token_type == TOKEN_REDIN)
-		{
-			redin = TRUE;
-		}
-	}
-	cmd->args[cmd->cnt] = NULL;
-	return 0;
+	error_print(NULL, PERROR);
+	exit(EXIT_EXEC_FAIL);
 }
 /*---------------------------------------------------------------------------*/
-int build_command(DynArray_T oTokens, char *args[])
+/* Map a waitpid() status to the exit status a shell reports */
+static int exit_status(int status)
 {
-	struct CommandInfo cmd = {0};
-	int ret = build_command_partial(oTokens, 0, dynarray_get_length(oTokens), &cmd);
-
-	if (ret == 0)
-	{
-		// Copy arguments to the provided array
-		for (int i = 0; i <= cmd.cnt; i++)
-		{ // Include NULL terminator
-			args[i] = cmd.args[i];
-		}
-		free(cmd.args); // Free the temporary array
-	}
+	if (WIFSIGNALED(status))
+		return 128 + WTERMSIG(status);
 
-	return ret;
+	return WEXITSTATUS(status);
 }
 /*---------------------------------------------------------------------------*/
-void execute_builtin(DynArray_T oTokens, enum BuiltinType btype)
+void execute_builtin(TokenVec_T oTokens, enum BuiltinType btype)
 {
-	int ret;
-	char *dir = NULL;
+	int i, ret, status = EXIT_SUCCESS;
+	char *dir = NULL, *name, *option;
+	char msg[256];
 	struct Token *t1;
+	long size;
 
 	switch (btype)
 	{
 	case B_EXIT:
-		if (dynarray_get_length(oTokens) == 1)
+		if (tokvec_get_length(oTokens) == 1)
 		{
-			// printf("\n");
-			dynarray_map(oTokens, free_token, NULL);
-			dynarray_free(oTokens);
-
-			exit(EXIT_SUCCESS);
+			exit(last_status);
 		}
 		else
+		{
 			error_print("exit does not take any parameters", FPRINTF);
+			status = EXIT_FAILURE;
+		}
 
 		break;
 
 	case B_CD:
-		if (dynarray_get_length(oTokens) == 1)
+		if (tokvec_get_length(oTokens) == 1)
 		{
 			dir = getenv("HOME");
 			if (dir == NULL)
 			{
 				error_print("cd: HOME variable not set", FPRINTF);
+				status = EXIT_FAILURE;
 				break;
 			}
 		}
-		else if (dynarray_get_length(oTokens) == 2)
+		else if (tokvec_get_length(oTokens) == 2)
 		{
-			t1 = dynarray_get(oTokens, 1);
+			t1 = tokvec_get(oTokens, 1);
 			if (t1->token_type == TOKEN_WORD)
-				dir = t1->token_value;
+				dir = tokvec_get_value(oTokens, 1);
 		}
 
 		if (dir == NULL)
 		{
 			error_print("cd takes one parameter", FPRINTF);
+			status = EXIT_FAILURE;
 			break;
 		}
 		else
 		{
 			ret = chdir(dir);
 			if (ret < 0)
+			{
 				error_print(NULL, PERROR);
+				status = EXIT_FAILURE;
+			}
+		}
+		break;
+
+	case B_HASH:
+		if (tokvec_get_length(oTokens) == 1)
+		{
+			cmdhash_print();
+			break;
+		}
+
+		for (i = 1; i < tokvec_get_length(oTokens); i++)
+		{
+			t1 = tokvec_get(oTokens, i);
+			if (t1->token_type != TOKEN_WORD)
+			{
+				error_print("hash takes -r, -p or command names", FPRINTF);
+				status = EXIT_FAILURE;
+				break;
+			}
+
+			name = tokvec_get_value(oTokens, i);
+			if (strcmp(name, "-r") == 0)
+				cmdhash_clear();
+			else if (strcmp(name, "-p") == 0)
+				plancache_print();
+			else if (cmdhash_lookup(name) == NULL)
+			{
+				// Pre-warming a missing name leaves a negative entry
+				snprintf(msg, sizeof(msg), "hash: %s: %s",
+						 name, strerror(errno));
+				error_print(msg, FPRINTF);
+				status = EXIT_FAILURE;
+			}
+		}
+		break;
+
+	case B_JOBS:
+		if (tokvec_get_length(oTokens) == 1)
+			jobs_print();
+		else
+		{
+			error_print("jobs does not take any parameters", FPRINTF);
+			status = EXIT_FAILURE;
+		}
+		break;
+
+	case B_STATS:
+		if (tokvec_get_length(oTokens) == 1)
+			stats_print(stdout);
+		else if (tokvec_get_length(oTokens) == 2 &&
+				 (name = tokvec_get_value(oTokens, 1)) != NULL &&
+				 strcmp(name, "-r") == 0)
+			stats_reset();
+		else
+		{
+			error_print("stats takes no parameters or -r", FPRINTF);
+			status = EXIT_FAILURE;
+		}
+		break;
+
+	case B_SET:
+		if (tokvec_get_length(oTokens) == 1 ||
+			(tokvec_get_length(oTokens) == 2 &&
+			 (name = tokvec_get_value(oTokens, 1)) != NULL &&
+			 strcmp(name, "-o") == 0))
+		{
+			printf("pipefail\t%s\n", pipefail ? "on" : "off");
+			printf("native\t%s\n", native_filters ? "on" : "off");
+			printf("optimize\t%s\n", optimize_lines ? "on" : "off");
+			if (pipebuf_size > 0)
+				printf("pipebuf\t%ld\n", pipebuf_size);
+			else
+				printf("pipebuf\tdefault\n");
+			break;
+		}
+
+		name = tokvec_get_value(oTokens, 1);
+		if (tokvec_get_length(oTokens) == 2 && name != NULL &&
+			strncmp(name, "pipebuf=", 8) == 0)
+		{
+			if ((size = pipebuf_parse(name + 8)) < 0)
+			{
+				error_print("set: pipebuf takes a size such as 1M",
+							FPRINTF);
+				status = EXIT_FAILURE;
+			}
+			else
+				pipebuf_size = size;
+			break;
+		}
+
+		option = tokvec_get_length(oTokens) == 3 ?
+			tokvec_get_value(oTokens, 2) : NULL;
+		if (name == NULL || option == NULL ||
+			(strcmp(option, "pipefail") != 0 &&
+			 strcmp(option, "native") != 0 &&
+			 strcmp(option, "optimize") != 0) ||
+			(strcmp(name, "-o") != 0 && strcmp(name, "+o") != 0))
+		{
+			error_print("set takes -o or +o pipefail, native or "
+						"optimize, or pipebuf=<size>", FPRINTF);
+			status = EXIT_FAILURE;
+			break;
+		}
+		if (strcmp(option, "pipefail") == 0)
+			pipefail = (name[0] == '-');
+		else if (strcmp(option, "native") == 0)
+			native_filters = (name[0] == '-');
+		else if (optimize_lines != (name[0] == '-'))
+		{
+			// Cached plans were compiled from the lines as they were
+			optimize_lines = (name[0] == '-');
+			plancache_clear();
 		}
 		break;
 
@@ -203,16 +258,34 @@ void execute_builtin(DynArray_T oTokens, enum BuiltinType btype)
 		error_print("Bug found in execute_builtin", FPRINTF);
 		exit(EXIT_FAILURE);
 	}
+
+	status_set(status);
 }
 /*---------------------------------------------------------------------------*/
 /* Important Notice!!
 	Add "signal(SIGINT, SIG_DFL);" after fork (only to child process)
 */
-int fork_exec(DynArray_T oTokens, int is_background)
+int fork_exec(const struct Plan *plan)
 {
 	pid_t pid;
-	int status;
-	struct CommandInfo cmd = {0};
+	int status, forked;
+	struct CommandInfo cmd = plan->stages[0];
+	int job_control = plan->own_group;
+	struct rusage usage = {0};
+	struct timespec start;
+	long long spawn_start, wait_start;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	// A builtin run in the foreground needs no process at all
+	if (cmd.builtin != NULL && !plan->background && !plan->timed)
+	{
+		status_set(builtin_run(&cmd));
+		return 0;
+	}
+
+	// Don't let the child inherit (or overtake) buffered output
+	fflush(stdout);
 
 	// Block SIGINT during fork
 	sigset_t mask, old_mask;
@@ -227,18 +300,41 @@ int fork_exec(DynArray_T oTokens, int is_background)
 	new_action.sa_flags = 0;
 	sigaction(SIGINT, &new_action, &old_action);
 
-	if (build_command_partial(oTokens, 0, dynarray_get_length(oTokens), &cmd) < 0)
+	spawn_start = stats_now();
+	if (cmd.builtin != NULL)
+		cmd.path = cmd.args[0];
+	else
+		cmd.path = cmdhash_lookup(cmd.args[0]);
+	if (cmd.path == NULL)
 	{
-		error_print("Memory allocation failed", FPRINTF);
+		// Not in PATH: report it without starting a child
+		error_print(NULL, PERROR);
+		status_set(EXIT_EXEC_FAIL);
 		sigaction(SIGINT, &old_action, NULL);
 		sigprocmask(SIG_SETMASK, &old_mask, NULL);
-		return -1;
+		return 0;
 	}
 
-	pid = fork();
+	// A builtin has nothing to exec, so its child is always forked
+	forked = (spawn_engine == SPAWN_FORK || cmd.builtin != NULL);
+	if (!forked)
+	{
+		pid = spawn_command(&cmd, job_control ? 0 : -1, -1, -1, -1);
+		if (pid < 0)
+		{
+			// Nothing was started; report it like the child would
+			error_print(NULL, PERROR);
+			status_set(EXIT_EXEC_FAIL);
+			sigaction(SIGINT, &old_action, NULL);
+			sigprocmask(SIG_SETMASK, &old_mask, NULL);
+			return 0;
+		}
+	}
+	else
+		pid = fork();
+
 	if (pid < 0)
 	{
-		free(cmd.args);
 		error_print(NULL, PERROR);
 		sigaction(SIGINT, &old_action, NULL);
 		sigprocmask(SIG_SETMASK, &old_mask, NULL);
@@ -265,7 +361,8 @@ int fork_exec(DynArray_T oTokens, int is_background)
 		sigprocmask(SIG_SETMASK, &mask, NULL);
 
 		// Create new process group
-		setpgid(0, 0);
+		if (job_control)
+			setpgid(0, 0);
 
 		if (cmd.redirect_in != NULL)
 		{
@@ -277,48 +374,54 @@ int fork_exec(DynArray_T oTokens, int is_background)
 			redout_handler(cmd.redirect_out);
 		}
 
-		execvp(cmd.args[0], cmd.args);
-		error_print(NULL, PERROR);
-		free(cmd.args);
-		exit(EXIT_FAILURE);
+		if (cmd.builtin != NULL)
+			builtin_exit(&cmd);
+		exec_command(&cmd);
 	}
 	else
 	{ // Parent process
-		setpgid(pid, pid);
+		stats_record(STAT_SPAWN, spawn_start);
+		trace_span("spawn", spawn_start, pid, job_control ? pid : 0,
+				   cmd.args[0]);
 
-		if (!is_background)
+		// posix_spawn already placed the child in its group
+		if (forked && job_control)
+			setpgid(pid, pid);
+		evloop_watch(pid);
+
+		if (!plan->background)
 		{
 			// Give terminal control to child
-			tcsetpgrp(STDIN_FILENO, pid);
-
-			// Restore original signal mask before waiting
-			sigprocmask(SIG_SETMASK, &old_mask, NULL);
-
-			if (waitpid(pid, &status, 0) < 0)
+			if (interactive)
 			{
-				error_print(NULL, PERROR);
-				free(cmd.args);
-				sigaction(SIGINT, &old_action, NULL);
-				return -1;
+				tcsetpgrp(STDIN_FILENO, pid);
+				trace_instant("tcsetpgrp", 0, pid, NULL);
 			}
 
+			wait_start = stats_now();
+			evloop_wait_children(&pid, 1, &status, &usage);
+			stats_record(STAT_WAIT, wait_start);
+			trace_span("wait", wait_start, pid, 0, NULL);
+			if (plan->timed)
+				rusage_print(stderr, rusage_since(&start), &usage);
+
+			status_set(exit_status(status));
+			if (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_EXEC_FAIL)
+				cmdhash_forget(cmd.args[0]);
+
 			// Restore terminal control to shell
-			tcsetpgrp(STDIN_FILENO, getpgrp());
+			if (interactive)
+			{
+				tcsetpgrp(STDIN_FILENO, getpgrp());
+				trace_instant("tcsetpgrp", 0, getpgrp(), NULL);
+			}
 		}
 		else
 		{
-			if (bg_list.count < MAX_BG_PRO)
-			{
-				fflush(stdout);
-				bg_list.processes[bg_list.count].pid = pid;
-				bg_list.processes[bg_list.count].pgid = pid;
-				bg_list.processes[bg_list.count].status = BG_PROCESS_RUNNING;
-				bg_list.processes[bg_list.count].cmd = strdup(cmd.args[0]);
-				bg_list.count++;
-				total_bg_cnt++;
-			}
+			status_set(EXIT_SUCCESS);
+			if (jobs_add(pid, pid, cmd.args[0]) < 0)
+				error_print("Cannot allocate memory", FPRINTF);
 		}
-		free(cmd.args);
 	}
 
 	// Restore original signal handlers
@@ -328,19 +431,138 @@ int fork_exec(DynArray_T oTokens, int is_background)
 	return pid;
 }
 /*---------------------------------------------------------------------------*/
+/* Fork the relay of a fan-out pipeline: it copies in, which the head
+   writes into, to cnt new pipes whose read ends are stored in fds[]
+   for the branches; fds[] has room for their write ends too.  The
+   relay joins pgid, or starts a group of its own if pgid is -1 and
+   job_control is set.  in is closed either way.  Return the relay's
+   pid, or -1 if it could not be started. */
+static pid_t fork_relay(int in, int *fds, int cnt, int job_control,
+						pid_t pgid, long pipe_size)
+{
+	static const int job_signals[] = {SIGINT, SIGQUIT, SIGTSTP, SIGTTIN,
+									  SIGTTOU, SIGCHLD};
+	int *writes = fds + cnt;
+	int b, pipe_fds[2];
+	sigset_t mask;
+	pid_t pid = -1;
+
+	for (b = 0; b < cnt; b++)
+	{
+		if (fdreg_pipe(pipe_fds) < 0)
+			break;
+		if (pipe_size > 0)
+			pipebuf_apply(pipe_fds[1], pipe_size);
+		fds[b] = pipe_fds[0];
+		writes[b] = pipe_fds[1];
+	}
+
+	if (b == cnt)
+		pid = fork();
+	if (pid == 0)
+	{
+		for (b = 0; b < (int)(sizeof(job_signals) / sizeof(int)); b++)
+			signal(job_signals[b], SIG_DFL);
+		sigemptyset(&mask);
+		sigprocmask(SIG_SETMASK, &mask, NULL);
+		if (job_control)
+			setpgid(0, pgid == -1 ? 0 : pgid);
+
+		// Keep only in, as stdin, and the write ends, as fds 3 and up:
+		// the shell's own descriptors stay with the shell, and a branch
+		// only sees EPIPE if no one else reads its pipe
+		dup2(in, STDIN_FILENO);
+		for (b = 0; b < cnt; b++)
+		{
+			writes[b] = fcntl(writes[b], F_DUPFD, 3 + cnt);
+			if (writes[b] < 0)
+				_exit(EXIT_FAILURE);
+		}
+		for (b = 0; b < cnt; b++)
+		{
+			dup2(writes[b], 3 + b);
+			writes[b] = 3 + b;
+		}
+		fdreg_close_from(3 + cnt);
+		_exit(fanout_relay(STDIN_FILENO, writes, cnt));
+	}
+
+	while (b-- > 0)
+	{
+		fdreg_close(writes[b]);
+		if (pid < 0)
+			fdreg_close(fds[b]);
+	}
+	fdreg_close(in);
+
+	return pid;
+}
+/*---------------------------------------------------------------------------*/
 /* Important Notice!!
 	Add "signal(SIGINT, SIG_DFL);" after fork (only to child process)
 */
-int iter_pipe_fork_exec(int pcount, DynArray_T oTokens, int is_background)
+int iter_pipe_fork_exec(const struct Plan *plan)
 {
-	int i, token_start, token_end;
+	int i;
 	int pipe_fds[2];
 	int prev_pipe_read = -1;
-	pid_t pid, first_child_pid = -1;
-	int cmd_count = pcount + 1;
-	int token_idx = 0;
+	pid_t pid, first_child_pid = 0;
+	int cmd_count = plan->stage_cnt;
 	int pgid = -1;
-	pid_t child_pids[MAX_FG_PRO];
+	pid_t *child_pids;
+	int *statuses;
+	int job_control = plan->own_group;
+	struct rusage usage = {0};
+	struct timespec start;
+	long long spawn_start, wait_start;
+	long pipe_size = plan->pipebuf >= 0 ? plan->pipebuf : pipebuf_size;
+	int forked, helper, last, k, proc_status = 0;
+	int *filter_status = NULL;
+	int piped, branch = 0, branch_cnt = 0, *branch_fds = NULL;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i < cmd_count; i++)
+	{
+		if (plan->stages[i].fanout)
+			branch_cnt++;
+	}
+
+	// One slot per stage, however long the pipeline is, and one for
+	// the relay of a fan-out pipeline
+	child_pids = calloc(cmd_count + 1, sizeof(pid_t));
+	statuses = malloc(sizeof(int) * (cmd_count + 1));
+	if (branch_cnt > 0)
+		branch_fds = malloc(sizeof(int) * 2 * branch_cnt);
+	if (child_pids == NULL || statuses == NULL ||
+		(branch_cnt > 0 && branch_fds == NULL))
+	{
+		error_print("Cannot allocate memory", FPRINTF);
+		free(child_pids);
+		free(statuses);
+		free(branch_fds);
+		return -1;
+	}
+
+	// Filter helpers leave the status of each stage they ran here;
+	// without it every stage runs the real command
+	for (i = 0; native_filters && i < cmd_count; i++)
+	{
+		if (plan->stages[i].filter != NULL)
+		{
+			filter_status = mmap(NULL, sizeof(int) * cmd_count,
+								 PROT_READ | PROT_WRITE,
+								 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+			if (filter_status == MAP_FAILED)
+				filter_status = NULL;
+			else
+				memset(filter_status, -1, sizeof(int) * cmd_count);
+			break;
+		}
+	}
+
+	// Don't let the children inherit (or overtake) buffered output
+	fflush(stdout);
 
 	// Block SIGTTOU and SIGINT while setting up processes
 	sigset_t mask, old_mask;
@@ -358,46 +580,132 @@ int iter_pipe_fork_exec(int pcount, DynArray_T oTokens, int is_background)
 
 	for (i = 0; i < cmd_count; i++)
 	{
-		token_start = token_idx;
-		while (token_idx < dynarray_get_length(oTokens))
+		// The first branch starts the relay that feeds them all
+		if (plan->stages[i].fanout && branch == 0)
 		{
-			struct Token *t = dynarray_get(oTokens, token_idx);
-			if (t->token_type == TOKEN_PIPE)
-				break;
-			token_idx++;
-		}
-		token_end = token_idx;
-		token_idx++;
-
-		if (i < cmd_count - 1)
-		{
-			if (pipe(pipe_fds) < 0)
+			pid = fork_relay(prev_pipe_read, branch_fds, branch_cnt,
+							 job_control, pgid, pipe_size);
+			prev_pipe_read = -1;
+			if (pid > 0 && pgid == -1)
 			{
-				error_print(NULL, PERROR);
-				for (int j = 0; j < i; j++)
+				pgid = pid;
+				first_child_pid = pid;
+				if (!plan->background && interactive)
 				{
-					kill(child_pids[j], SIGTERM);
+					tcsetpgrp(STDIN_FILENO, pgid);
+					trace_instant("tcsetpgrp", 0, pgid, NULL);
 				}
-				sigprocmask(SIG_SETMASK, &old_mask, NULL);
-				sigaction(SIGINT, &old_action, NULL);
-				return -1;
 			}
+			if (pid > 0 && job_control)
+				setpgid(pid, pgid);
+			if (pid > 0)
+				evloop_watch(pid);
+			else
+				branch = branch_cnt; // Its pipes are gone already
+			child_pids[cmd_count] = pid;
 		}
-
-		pid = fork();
-
-		if (pid < 0)
+		if (plan->stages[i].fanout && child_pids[cmd_count] > 0)
+			prev_pipe_read = branch_fds[branch++];
+
+		// Consecutive native filters share one helper process
+		last = i;
+		helper = (filter_status != NULL && plan->stages[i].filter != NULL);
+		while (helper && last < cmd_count - 1 &&
+			   last - i + 1 < FILTER_MAX_RUN &&
+			   plan->stages[last + 1].filter != NULL &&
+			   !plan->stages[last + 1].fanout)
+			last++;
+
+		// A stage writes into the next one, or into the relay if it
+		// ends the head; the end of a branch writes where the shell does
+		piped = last < cmd_count - 1 &&
+			(!plan->stages[last + 1].fanout || branch == 0);
+
+		if (child_pids[cmd_count] < 0 || (piped && fdreg_pipe(pipe_fds) < 0))
 		{
 			error_print(NULL, PERROR);
-			for (int j = 0; j < i; j++)
+			if (prev_pipe_read != -1)
+				fdreg_close(prev_pipe_read);
+			for (k = branch; k < branch_cnt; k++)
+				fdreg_close(branch_fds[k]);
+			for (int j = 0; j <= cmd_count; j++)
 			{
-				kill(child_pids[j], SIGTERM);
+				if (child_pids[j] > 0)
+					kill(child_pids[j], SIGTERM);
 			}
 			sigprocmask(SIG_SETMASK, &old_mask, NULL);
 			sigaction(SIGINT, &old_action, NULL);
+			if (filter_status != NULL)
+				munmap(filter_status, sizeof(int) * cmd_count);
+			free(child_pids);
+			free(statuses);
+			free(branch_fds);
 			return -1;
 		}
 
+		if (piped)
+		{
+			// The writer's end decides; both ends share one buffer
+			if (pipe_size > 0)
+				pipebuf_apply(pipe_fds[1], pipe_size);
+		}
+
+		// Resolve the stage in the parent so the PATH cache is kept
+		struct CommandInfo cmd = plan->stages[i];
+
+		pid = -1;
+		spawn_start = stats_now();
+		forked = (spawn_engine == SPAWN_FORK || cmd.builtin != NULL ||
+				  helper);
+		if (cmd.builtin != NULL || helper)
+			cmd.path = cmd.args[0];
+		else
+			cmd.path = cmdhash_lookup(cmd.args[0]);
+
+		if (cmd.path == NULL)
+			error_print(NULL, PERROR);
+		else if (!forked)
+		{
+			pid = spawn_command(&cmd,
+								!job_control ? -1 : pgid == -1 ? 0 : pgid,
+								prev_pipe_read,
+								piped ? pipe_fds[1] : -1,
+								piped ? pipe_fds[0] : -1);
+			if (pid < 0)
+				error_print(NULL, PERROR);
+		}
+		else
+		{
+			pid = fork();
+
+			if (pid < 0)
+			{
+				error_print(NULL, PERROR);
+				if (prev_pipe_read != -1)
+					fdreg_close(prev_pipe_read);
+				if (piped)
+				{
+					fdreg_close(pipe_fds[0]);
+					fdreg_close(pipe_fds[1]);
+				}
+				for (k = branch; k < branch_cnt; k++)
+					fdreg_close(branch_fds[k]);
+				for (int j = 0; j <= cmd_count; j++)
+				{
+					if (child_pids[j] > 0)
+						kill(child_pids[j], SIGTERM);
+				}
+				sigprocmask(SIG_SETMASK, &old_mask, NULL);
+				sigaction(SIGINT, &old_action, NULL);
+				if (filter_status != NULL)
+					munmap(filter_status, sizeof(int) * cmd_count);
+				free(child_pids);
+				free(statuses);
+				free(branch_fds);
+				return -1;
+			}
+		}
+
 		if (pid == 0)
 		{ // Child process
 		  // Restore original signal mask and handlers in child
@@ -418,11 +726,14 @@ int iter_pipe_fork_exec(int pcount, DynArray_T oTokens, int is_background)
 			sigemptyset(&mask);
 			sigprocmask(SIG_SETMASK, &mask, NULL);
 
-			if (pgid == -1)
+			if (job_control)
 			{
-				pgid = getpid();
+				if (pgid == -1)
+				{
+					pgid = getpid();
+				}
+				setpgid(0, pgid);
 			}
-			setpgid(0, pgid);
 
 			if (prev_pipe_read != -1)
 			{
@@ -430,7 +741,7 @@ int iter_pipe_fork_exec(int pcount, DynArray_T oTokens, int is_background)
 				close(prev_pipe_read);
 			}
 
-			if (i < cmd_count - 1)
+			if (piped)
 			{
 				close(pipe_fds[0]);
 				dup2(pipe_fds[1], STDOUT_FILENO);
@@ -438,139 +749,165 @@ int iter_pipe_fork_exec(int pcount, DynArray_T oTokens, int is_background)
 			}
 
 			// Close all other file descriptors
-			for (int j = 3; j < 256; j++)
-			{
-				close(j);
-			}
+			fdreg_close_from(3);
 
-			struct CommandInfo cmd = {0};
-			if (build_command_partial(oTokens, token_start, token_end, &cmd) < 0)
+			// Handle redirection for first and last command
+			if (i == 0 && cmd.redirect_in != NULL)
 			{
-				error_print("Command building failed", FPRINTF);
-				exit(EXIT_FAILURE);
+				redin_handler(cmd.redirect_in);
 			}
 
-			// Handle redirection for last command
-			if (i == cmd_count - 1 && cmd.redirect_out != NULL)
+			if (!piped && plan->stages[last].redirect_out != NULL)
 			{
-				int fd = open(cmd.redirect_out, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+				int fd = open(plan->stages[last].redirect_out,
+							  O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
 				if (fd < 0)
 				{
 					error_print(NULL, PERROR);
-					free(cmd.args);
 					exit(EXIT_FAILURE);
 				}
 				if (dup2(fd, STDOUT_FILENO) < 0)
 				{
 					error_print(NULL, PERROR);
 					close(fd);
-					free(cmd.args);
 					exit(EXIT_FAILURE);
 				}
 				close(fd);
 			}
 
-			execvp(cmd.args[0], cmd.args);
-			free(cmd.args);
-			error_print(NULL, PERROR);
-			exit(EXIT_FAILURE);
+			if (helper)
+				_exit(filter_run(&plan->stages[i], last - i + 1,
+								 STDIN_FILENO, STDOUT_FILENO,
+								 filter_status + i));
+
+			// A builtin stage runs here rather than next to the shell,
+			// so it cannot block the shell on a full pipe
+			if (cmd.builtin != NULL)
+				builtin_exit(&cmd);
+			exec_command(&cmd);
 		}
 		else
 		{ // Parent process
+			// A stage that never started is treated like one that exited:
+			// its pipe ends are still closed below, so neighbours see EOF
 			child_pids[i] = pid;
 
-			if (pgid == -1)
+			if (pid > 0 && pgid == -1)
 			{
 				pgid = pid;
 				first_child_pid = pid;
-			}
-			setpgid(pid, pgid);
 
-			// Give terminal control to the process group if foreground
-			if (!is_background && i == 0)
+				// Give terminal control to the process group if foreground
+				if (!plan->background && interactive)
+				{
+					tcsetpgrp(STDIN_FILENO, pgid);
+					trace_instant("tcsetpgrp", 0, pgid, NULL);
+				}
+			}
+			if (pid > 0 && forked && job_control)
+				setpgid(pid, pgid);
+			if (pid > 0)
 			{
-				tcsetpgrp(STDIN_FILENO, pgid);
+				stats_record(STAT_SPAWN, spawn_start);
+				trace_span("spawn", spawn_start, pid, job_control ? pgid : 0,
+						   cmd.args[0]);
+				evloop_watch(pid);
 			}
 
 			if (prev_pipe_read != -1)
 			{
-				close(prev_pipe_read);
+				fdreg_close(prev_pipe_read);
 			}
 
-			if (i < cmd_count - 1)
+			if (piped)
 			{
-				close(pipe_fds[1]);
+				fdreg_close(pipe_fds[1]);
 				prev_pipe_read = pipe_fds[0];
 			}
+			else
+				prev_pipe_read = -1;
+
+			// The helper's other stages have no process of their own
+			for (k = i + 1; k <= last; k++)
+				child_pids[k] = 0;
+			i = last;
 		}
 	}
 
 	// Parent process cleanup and waiting
-	if (!is_background)
+	if (!plan->background)
 	{
-		int status;
-
-		// Restore original signal handling before waiting
-		sigprocmask(SIG_SETMASK, &old_mask, NULL);
-
+		wait_start = stats_now();
+		evloop_wait_children(child_pids, cmd_count + 1, statuses, &usage);
+		stats_record(STAT_WAIT, wait_start);
+		trace_span("wait", wait_start, 0, job_control ? pgid : 0, NULL);
+		if (plan->timed)
+			rusage_print(stderr, rusage_since(&start), &usage);
+
+		// Turn wait statuses into exit statuses, stage by stage; a
+		// stage that never started counts as not found
 		for (i = 0; i < cmd_count; i++)
 		{
-			if (waitpid(child_pids[i], &status, 0) < 0)
+			if (child_pids[i] < 0)
 			{
-				if (errno != ECHILD)
-				{
-					error_print(NULL, PERROR);
-					sigaction(SIGINT, &old_action, NULL);
-					return -1;
-				}
+				statuses[i] = EXIT_EXEC_FAIL;
+				continue;
+			}
+
+			// A filter helper stores the status of each of its stages,
+			// unless it was killed before it could
+			if (child_pids[i] > 0)
+				proc_status = exit_status(statuses[i]);
+			if (filter_status != NULL && filter_status[i] >= 0)
+			{
+				statuses[i] = filter_status[i];
+				continue;
 			}
+			if (child_pids[i] == 0)
+			{
+				statuses[i] = proc_status;
+				continue;
+			}
+
+			if (WIFEXITED(statuses[i]) &&
+				WEXITSTATUS(statuses[i]) == EXIT_EXEC_FAIL)
+				cmdhash_forget(plan->stages[i].args[0]);
+			statuses[i] = exit_status(statuses[i]);
 		}
+		status_set_pipeline(statuses, cmd_count);
 
 		// Restore terminal control to shell
-		tcsetpgrp(STDIN_FILENO, getpgrp());
+		if (interactive)
+		{
+			tcsetpgrp(STDIN_FILENO, getpgrp());
+			trace_instant("tcsetpgrp", 0, getpgrp(), NULL);
+		}
 	}
 	else
 	{
-		// Background process handling remains the same
+		status_set(EXIT_SUCCESS);
+		// Record every started stage in the job table
 		for (i = 0; i < cmd_count; i++)
 		{
-			if (bg_list.count < MAX_BG_PRO)
-			{
-				bg_list.processes[bg_list.count].pid = child_pids[i];
-				bg_list.processes[bg_list.count].pgid = pgid;
-				bg_list.processes[bg_list.count].status = BG_PROCESS_RUNNING;
-
-				struct CommandInfo cmd = {0};
-				build_command_partial(oTokens, token_start, token_end, &cmd);
-				bg_list.processes[bg_list.count].cmd = strdup(cmd.args[0]);
-				free(cmd.args);
-
-				bg_list.count++;
-				total_bg_cnt++;
-			}
+			if (child_pids[i] > 0 &&
+				jobs_add(child_pids[i], pgid, plan->stages[i].args[0]) < 0)
+				error_print("Cannot allocate memory", FPRINTF);
 		}
+		if (child_pids[cmd_count] > 0 &&
+			jobs_add(child_pids[cmd_count], pgid, "|+") < 0)
+			error_print("Cannot allocate memory", FPRINTF);
 	}
 
 	// Restore original signal handlers
 	sigaction(SIGINT, &old_action, NULL);
 	sigprocmask(SIG_SETMASK, &old_mask, NULL);
 
+	if (filter_status != NULL)
+		munmap(filter_status, sizeof(int) * cmd_count);
+	free(child_pids);
+	free(statuses);
+	free(branch_fds);
+
 	return first_child_pid;
 }
 /*---------------------------------------------------------------------------*/
-void print_jobs(void)
-{
-	for (int i = 0; i < bg_list.count; i++)
-	{
-		if (bg_list.processes[i].status == BG_PROCESS_RUNNING)
-		{
-			// Check if process still exists
-			if (kill(bg_list.processes[i].pid, 0) == 0)
-			{
-				printf("[%d] Running\t%s\n",
-					   bg_list.processes[i].pid,
-					   bg_list.processes[i].cmd);
-			}
-		}
-	}
-}
\ No newline at end of file
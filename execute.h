@@ -16,28 +16,23 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 
-#include "dynarray.h"
+#include "token.h"
+#include "arena.h"
 #include "util.h"
 #include "snush.h"
+#include "plan.h"
 
-#define B_JOBS 2
+/* Exit status of a child whose exec failed */
+enum {EXIT_EXEC_FAIL = 127};
+
+/* Exit status of a line that failed to lex or parse */
+enum {EXIT_SYNTAX = 2};
 
-void print_jobs(void);
 void redout_handler(char *fname);
 void redin_handler(char *fname);
-struct CommandInfo
-{
-    char *redirect_out; // File for output redirection
-    char *redirect_in;  // File for input redirection
-    int cnt;            // Number of arguments
-    char **args;        // Dynamic array of argument pointers
-};
-
-int build_command_partial(DynArray_T oTokens, int start, int end, struct CommandInfo *cmd);
-int build_command(DynArray_T oTokens, char *args[]);
-void execute_builtin(DynArray_T oTokens, enum BuiltinType btype);
-int fork_exec(DynArray_T oTokens, int is_background);
-int iter_pipe_fork_exec(int pCount, DynArray_T oTokens, int is_background);
+void execute_builtin(TokenVec_T oTokens, enum BuiltinType btype);
+int fork_exec(const struct Plan *plan);
+int iter_pipe_fork_exec(const struct Plan *plan);
 
 struct RedirectionInfo
 {
@@ -0,0 +1,213 @@
+/*---------------------------------------------------------------------------*/
+/* fanout.c                                                                  */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include "fanout.h"
+#include "util.h"
+
+/* The most a round of tee() and splice() moves */
+enum {FANOUT_CHUNK = 1 << 20};
+
+/*---------------------------------------------------------------------------*/
+/* Return how many bytes the pipe out can take, waiting until it can
+   take some.  If that cannot be found out, let tee() find out. */
+static long room(int out) {
+    struct pollfd p = {out, POLLOUT, 0};
+    int cap, queued;
+
+    for (;;) {
+        cap = fcntl(out, F_GETPIPE_SZ);
+        if (cap < 0 || ioctl(out, FIONREAD, &queued) < 0)
+            return FANOUT_CHUNK;
+        if (queued < cap)
+            return cap - queued;
+        if (poll(&p, 1, -1) < 0 && errno != EINTR)
+            return FANOUT_CHUNK;
+        if (p.revents & (POLLERR | POLLHUP))
+            return FANOUT_CHUNK;
+    }
+}
+/*---------------------------------------------------------------------------*/
+static long retry_tee(int in, int out, long len) {
+    long r;
+
+    while ((r = tee(in, out, len, 0)) < 0 && errno == EINTR)
+        ;
+    return r;
+}
+/*---------------------------------------------------------------------------*/
+/* Read exactly len bytes that are known to be waiting in in */
+static int read_all(int in, char *buf, long len) {
+    long r;
+
+    while (len > 0) {
+        r = read(in, buf, len);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return -1;
+        buf += r;
+        len -= r;
+    }
+    return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int write_all(int out, const char *buf, long len) {
+    long r;
+
+    while (len > 0) {
+        r = write(out, buf, len);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0)
+            return -1;
+        buf += r;
+        len -= r;
+    }
+    return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Move the first len bytes of in to out.  Return how many were moved;
+   if not all of them, errno says why. */
+static long splice_all(int in, int out, long len) {
+    long r, done = 0;
+
+    while (done < len) {
+        r = splice(in, NULL, out, NULL, len - done, SPLICE_F_MOVE);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            break;
+        done += r;
+    }
+    return done;
+}
+/*---------------------------------------------------------------------------*/
+int fanout_relay(int in, int *outs, int cnt) {
+    long len, limit, taken, r, *teed;
+    char *buf = NULL;
+    int i, j, last, copy, ret = 0;
+
+    /* A branch that goes away shows up as EPIPE */
+    signal(SIGPIPE, SIG_IGN);
+
+    teed = malloc(sizeof(long) * cnt);
+    if (teed == NULL)
+        ret = 1;
+
+    while (ret == 0 && cnt > 0) {
+        /* With one branch left the data only has to be moved */
+        if (cnt == 1) {
+            r = splice(in, NULL, outs[0], NULL, FANOUT_CHUNK,
+                       SPLICE_F_MOVE);
+            if (r > 0 || (r < 0 && errno == EINTR))
+                continue;
+            if (r < 0 && errno != EPIPE)
+                ret = 1;
+            break;
+        }
+
+        /* Take no more than every branch has room for, so that each
+           tee() can duplicate all of it */
+        limit = FANOUT_CHUNK;
+        for (i = 0; i < cnt; i++) {
+            r = room(outs[i]);
+            if (r < limit)
+                limit = r;
+        }
+
+        /* The first branch decides how much this round moves */
+        len = retry_tee(in, outs[0], limit);
+        if (len == 0)
+            break;
+        if (len < 0) {
+            if (errno != EPIPE)
+                ret = 1;
+            close(outs[0]);
+            outs[0] = outs[--cnt];
+            continue;
+        }
+
+        last = cnt - 1;
+        copy = FALSE;
+        teed[0] = len;
+        for (i = 1; i < last; i++) {
+            teed[i] = retry_tee(in, outs[i], len);
+            if (teed[i] < 0 && errno != EPIPE) {
+                ret = 1;
+                break;
+            }
+            if (teed[i] >= 0 && teed[i] < len)
+                copy = TRUE;
+        }
+        if (ret != 0)
+            break;
+
+        /* The last branch gets the data itself, unless some branch
+           needs part of it copied */
+        taken = 0;
+        teed[last] = 0;
+        if (!copy) {
+            taken = splice_all(in, outs[last], len);
+            teed[last] = taken;
+            if (taken < len) {
+                if (errno != EPIPE) {
+                    ret = 1;
+                    break;
+                }
+                teed[last] = -1;
+            }
+        }
+
+        if (taken < len) {
+            /* Take the rest of the round out of in and write each
+               branch what it has not had yet */
+            if (buf == NULL && (buf = malloc(FANOUT_CHUNK)) == NULL) {
+                ret = 1;
+                break;
+            }
+            if (read_all(in, buf, len - taken) < 0) {
+                ret = 1;
+                break;
+            }
+            for (i = 0; i < cnt; i++) {
+                if (teed[i] < 0 || teed[i] == len)
+                    continue;
+                r = write_all(outs[i], buf + teed[i] - taken, len - teed[i]);
+                if (r < 0 && errno != EPIPE) {
+                    ret = 1;
+                    break;
+                }
+                if (r < 0)
+                    teed[i] = -1;
+            }
+        }
+
+        /* Forget the branches that went away */
+        for (i = j = 0; i < cnt; i++) {
+            if (teed[i] < 0)
+                close(outs[i]);
+            else
+                outs[j++] = outs[i];
+        }
+        cnt = j;
+    }
+
+    for (i = 0; i < cnt; i++)
+        close(outs[i]);
+    close(in);
+    free(teed);
+    free(buf);
+
+    return ret;
+}
+/*---------------------------------------------------------------------------*/
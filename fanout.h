@@ -0,0 +1,23 @@
+/*---------------------------------------------------------------------------*/
+/* fanout.h                                                                  */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#ifndef _FANOUT_H_
+#define _FANOUT_H_
+
+/* "cmd |+ a |+ b" feeds everything cmd writes to both a and b.  The
+   head of the pipeline writes into a pipe read by a relay process,
+   which has one pipe to each branch.  The relay duplicates the data
+   with tee(2) and moves it into the last branch with splice(2), so the
+   bytes themselves stay in the kernel; only when a branch has less
+   room than the others does it copy the part that branch could not
+   take through a buffer of its own.  A branch that exits is dropped,
+   and the relay ends when its input does or no branch is left. */
+
+/* Relay in to each of the cnt pipes in outs as described above, and
+   close them all.  Return 0, or 1 if reading or writing failed for a
+   reason other than a branch going away. */
+int fanout_relay(int in, int *outs, int cnt);
+
+#endif /* _FANOUT_H_ */
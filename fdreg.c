@@ -0,0 +1,125 @@
+/*---------------------------------------------------------------------------*/
+/* fdreg.c                                                                   */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include "fdreg.h"
+
+enum {WORD_BITS = sizeof(unsigned long) * CHAR_BIT};
+
+/* One bit per descriptor number */
+static unsigned long *fd_bits;
+static int word_cnt;
+static int fd_cnt;
+
+/*---------------------------------------------------------------------------*/
+static int mark(int fd) {
+    int words = fd / WORD_BITS + 1;
+    unsigned long *bits;
+
+    if (words > word_cnt) {
+        if (words < word_cnt * 2)
+            words = word_cnt * 2;
+
+        bits = realloc(fd_bits, words * sizeof(unsigned long));
+        if (bits == NULL)
+            return -1;
+        memset(bits + word_cnt, 0,
+               (words - word_cnt) * sizeof(unsigned long));
+        fd_bits = bits;
+        word_cnt = words;
+    }
+
+    fd_bits[fd / WORD_BITS] |= 1UL << (fd % WORD_BITS);
+    fd_cnt++;
+
+    return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int marked(int fd) {
+    return fd / WORD_BITS < word_cnt &&
+           (fd_bits[fd / WORD_BITS] & (1UL << (fd % WORD_BITS))) != 0;
+}
+/*---------------------------------------------------------------------------*/
+int fdreg_add(int fd) {
+    if (fd < 0)
+        return -1;
+
+    if (mark(fd) < 0) {
+        close(fd);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    return fd;
+}
+/*---------------------------------------------------------------------------*/
+int fdreg_open(const char *path, int flags, mode_t mode) {
+    return fdreg_add(open(path, flags | O_CLOEXEC, mode));
+}
+/*---------------------------------------------------------------------------*/
+int fdreg_pipe(int fds[2]) {
+    if (pipe2(fds, O_CLOEXEC) < 0)
+        return -1;
+
+    if (fdreg_add(fds[0]) < 0) {
+        close(fds[1]);
+        return -1;
+    }
+    if (fdreg_add(fds[1]) < 0) {
+        fdreg_close(fds[0]);
+        return -1;
+    }
+
+    return 0;
+}
+/*---------------------------------------------------------------------------*/
+int fdreg_close(int fd) {
+    if (marked(fd)) {
+        fd_bits[fd / WORD_BITS] &= ~(1UL << (fd % WORD_BITS));
+        fd_cnt--;
+    }
+
+    return close(fd);
+}
+/*---------------------------------------------------------------------------*/
+int fdreg_count(void) {
+    return fd_cnt;
+}
+/*---------------------------------------------------------------------------*/
+void fdreg_close_from(int lowfd) {
+    struct dirent *d;
+    DIR *dir;
+    int fd;
+
+    if (close_range(lowfd, ~0U, 0) == 0)
+        return;
+
+    /* Kernels before 5.9 have no close_range() */
+    dir = opendir("/proc/self/fd");
+    if (dir != NULL) {
+        while ((d = readdir(dir)) != NULL) {
+            if (d->d_name[0] == '.')
+                continue;
+            fd = atoi(d->d_name);
+            if (fd >= lowfd && fd != dirfd(dir))
+                close(fd);
+        }
+        closedir(dir);
+        return;
+    }
+
+    /* Without /proc, at least the shell's own descriptors go */
+    for (fd = lowfd; fd < word_cnt * (int)WORD_BITS; fd++)
+        if (marked(fd))
+            close(fd);
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,39 @@
+/*---------------------------------------------------------------------------*/
+/* fdreg.h                                                                   */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#ifndef _FDREG_H_
+#define _FDREG_H_
+
+#include <sys/types.h>
+
+/* Every file descriptor the shell holds for itself is created
+   close-on-exec and recorded here, so none of them can leak into a
+   command, and the shell knows which descriptors are its own. */
+
+/* Like open(2) with O_CLOEXEC added.  Return the new descriptor, or
+   -1 with errno set. */
+int fdreg_open(const char *path, int flags, mode_t mode);
+
+/* Like pipe2(fds, O_CLOEXEC).  Return 0, or -1 with errno set. */
+int fdreg_pipe(int fds[2]);
+
+/* Record fd, which must have been created close-on-exec (e.g. by
+   epoll_create1(EPOLL_CLOEXEC) or pidfd_open()).  Return fd, or -1 with
+   errno set and fd closed if insufficient memory is available. */
+int fdreg_add(int fd);
+
+/* Close fd and forget it.  Return what close(2) returns. */
+int fdreg_close(int fd);
+
+/* Return the number of descriptors recorded. */
+int fdreg_count(void);
+
+/* Close every descriptor from lowfd up, recorded or not.  Meant for a
+   child before exec: uses close_range(2), or walks /proc/self/fd where
+   that is missing, or closes the recorded descriptors as a last
+   resort. */
+void fdreg_close_from(int lowfd);
+
+#endif /* _FDREG_H_ */
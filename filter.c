@@ -0,0 +1,595 @@
+/*---------------------------------------------------------------------------*/
+/* filter.c                                                                  */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "filter.h"
+#include "pipebuf.h"
+#include "util.h"
+
+enum {BUF_SIZE = 128 * 1024};
+enum {SPLICE_CHUNK = 1 << 20};
+
+/* Pipes between two native stages are sized like this, if the kernel
+   allows it */
+enum {INNER_PIPE_SIZE = 1 << 20};
+
+/* The status of a command killed by SIGPIPE */
+enum {EXIT_PIPE = 128 + SIGPIPE};
+
+int native_filters = TRUE;
+
+/* Buffered output of one stage */
+struct Output {
+    int fd;
+    size_t len;
+    char buf[BUF_SIZE];
+};
+
+/* One stage running as a thread */
+struct Stage {
+    FilterFn fn;
+    int argc;
+    char **argv;
+    int in, out;
+    int status;
+    pthread_t tid;
+};
+
+/*---------------------------------------------------------------------------*/
+static int write_all(int fd, const char *buf, size_t len) {
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+
+    return 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Report what failed in the filter called name, with errno, and return
+   the status the real command would have.  The message is worded like
+   the real command's, without the shell's name, and written at once so
+   that stages failing together don't mix their lines.  A closed pipe
+   is not reported: the command would have died of SIGPIPE. */
+static int failed(const char *name, const char *what, int status) {
+    char msg[256];
+    int len;
+
+    if (errno == EPIPE)
+        return EXIT_PIPE;
+
+    if (what != NULL)
+        len = snprintf(msg, sizeof(msg), "%s: %s: %s\n", name, what,
+                       strerror(errno));
+    else
+        len = snprintf(msg, sizeof(msg), "%s: %s\n", name, strerror(errno));
+    if (len >= (int)sizeof(msg)) {
+        len = sizeof(msg) - 1;
+        msg[len - 1] = '\n';
+    }
+    write_all(STDERR_FILENO, msg, len);
+
+    return status;
+}
+/*---------------------------------------------------------------------------*/
+static int out_flush(struct Output *o) {
+    int ret = write_all(o->fd, o->buf, o->len);
+
+    o->len = 0;
+    return ret;
+}
+/*---------------------------------------------------------------------------*/
+static int out_put(struct Output *o, const char *data, size_t len) {
+    if (o->len + len > BUF_SIZE && out_flush(o) < 0)
+        return -1;
+    if (len >= BUF_SIZE)
+        return write_all(o->fd, data, len);
+
+    memcpy(o->buf + o->len, data, len);
+    o->len += len;
+    return 0;
+}
+/*---------------------------------------------------------------------------*/
+static ssize_t read_some(int fd, char *buf, size_t len) {
+    ssize_t n;
+
+    do
+        n = read(fd, buf, len);
+    while (n < 0 && errno == EINTR);
+
+    return n;
+}
+/*---------------------------------------------------------------------------*/
+/* Copy up to limit bytes, or everything if limit is negative, from in
+   to out.  The data stays in the kernel when one side is a pipe.
+   Return 0, or -1 with errno set. */
+static int copy(int in, int out, long long limit) {
+    int use_splice = TRUE;
+    char *buf = NULL;
+    size_t want;
+    ssize_t n;
+
+    while (limit != 0) {
+        want = (limit < 0 || limit > SPLICE_CHUNK) ? SPLICE_CHUNK : limit;
+
+        if (use_splice) {
+            n = splice(in, NULL, out, NULL, want, SPLICE_F_MOVE);
+            if (n < 0 && (errno == EINVAL || errno == ENOSYS)) {
+                /* Neither side is a pipe, or one is a terminal */
+                use_splice = FALSE;
+                continue;
+            }
+        }
+        else {
+            if (buf == NULL && (buf = malloc(BUF_SIZE)) == NULL)
+                return -1;
+            n = read_some(in, buf, want < BUF_SIZE ? want : BUF_SIZE);
+            if (n > 0 && write_all(out, buf, n) < 0)
+                n = -1;
+        }
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0) {
+            free(buf);
+            return n;
+        }
+        if (limit > 0)
+            limit -= n;
+    }
+
+    free(buf);
+    return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int cat_main(int argc, char *argv[], int in, int out) {
+    int i, fd, status = EXIT_SUCCESS;
+
+    if (argc == 1)
+        return copy(in, out, -1) < 0 ? failed("cat", NULL, EXIT_FAILURE)
+            : EXIT_SUCCESS;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-") == 0)
+            fd = in;
+        else if ((fd = open(argv[i], O_RDONLY | O_CLOEXEC)) < 0) {
+            status = failed("cat", argv[i], EXIT_FAILURE);
+            continue;
+        }
+
+        if (copy(fd, out, -1) < 0)
+            status = failed("cat", argv[i], EXIT_FAILURE);
+        if (fd != in)
+            close(fd);
+        if (status == EXIT_PIPE)
+            break;
+    }
+
+    return status;
+}
+/*---------------------------------------------------------------------------*/
+/* Return TRUE if s is a nonempty string of digits, storing its value
+   in *n. */
+static int parse_count(const char *s, long long *n) {
+    char *end;
+
+    if (*s < '0' || *s > '9')
+        return FALSE;
+    *n = strtoll(s, &end, 10);
+
+    return *end == '\0';
+}
+/*---------------------------------------------------------------------------*/
+/* Parse the arguments of head into a line or byte count. */
+static int head_args(int argc, char *argv[], long long *count, int *bytes) {
+    *count = 10;
+    *bytes = FALSE;
+
+    if (argc == 1)
+        return TRUE;
+    if (argc == 2 && argv[1][0] == '-' &&
+        (argv[1][1] == 'n' || argv[1][1] == 'c')) {
+        *bytes = (argv[1][1] == 'c');
+        return parse_count(argv[1] + 2, count);
+    }
+    if (argc == 2 && argv[1][0] == '-')
+        return parse_count(argv[1] + 1, count);
+    if (argc == 3 && (strcmp(argv[1], "-n") == 0 ||
+                      strcmp(argv[1], "-c") == 0)) {
+        *bytes = (argv[1][1] == 'c');
+        return parse_count(argv[2], count);
+    }
+
+    return FALSE;
+}
+/*---------------------------------------------------------------------------*/
+static int head_main(int argc, char *argv[], int in, int out) {
+    long long count;
+    int bytes;
+    char *buf, *p;
+    ssize_t n = 0;
+    size_t len;
+
+    head_args(argc, argv, &count, &bytes);
+    if (bytes)
+        return copy(in, out, count) < 0 ? failed("head", NULL, EXIT_FAILURE)
+            : EXIT_SUCCESS;
+
+    if ((buf = malloc(BUF_SIZE)) == NULL)
+        return failed("head", NULL, EXIT_FAILURE);
+
+    while (count > 0 && (n = read_some(in, buf, BUF_SIZE)) > 0) {
+        /* Stop right after the last wanted newline */
+        for (p = buf; count > 0 && p < buf + n; p++) {
+            p = memchr(p, '\n', buf + n - p);
+            if (p == NULL) {
+                p = buf + n;
+                break;
+            }
+            count--;
+        }
+        len = (count == 0) ? (size_t)(p - buf) : (size_t)n;
+        if (write_all(out, buf, len) < 0) {
+            n = -1;
+            break;
+        }
+    }
+
+    free(buf);
+    return n < 0 ? failed("head", NULL, EXIT_FAILURE) : EXIT_SUCCESS;
+}
+/*---------------------------------------------------------------------------*/
+/* Parse the options of wc into a combination of 'l', 'w' and 'c' */
+static int wc_args(int argc, char *argv[], int *lines, int *words,
+                   int *bytes) {
+    const char *p;
+    int i;
+
+    *lines = *words = *bytes = (argc == 1);
+    for (i = 1; i < argc; i++) {
+        if (argv[i][0] != '-' || argv[i][1] == '\0')
+            return FALSE;
+        for (p = argv[i] + 1; *p != '\0'; p++) {
+            if (*p == 'l')
+                *lines = TRUE;
+            else if (*p == 'w')
+                *words = TRUE;
+            else if (*p == 'c')
+                *bytes = TRUE;
+            else
+                return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+/*---------------------------------------------------------------------------*/
+static int wc_main(int argc, char *argv[], int in, int out) {
+    long long counts[3] = {0, 0, 0};
+    int lines, words, bytes, in_word = FALSE, fields = 0;
+    char *buf, *p, msg[80];
+    size_t len = 0;
+    ssize_t n;
+    int i;
+
+    wc_args(argc, argv, &lines, &words, &bytes);
+    if ((buf = malloc(BUF_SIZE)) == NULL)
+        return failed("wc", NULL, EXIT_FAILURE);
+
+    while ((n = read_some(in, buf, BUF_SIZE)) > 0) {
+        counts[2] += n;
+        if (words) {
+            for (i = 0; i < n; i++) {
+                if (buf[i] == '\n')
+                    counts[0]++;
+                if (buf[i] == ' ' || (buf[i] >= '\t' && buf[i] <= '\r'))
+                    in_word = FALSE;
+                else if (!in_word) {
+                    in_word = TRUE;
+                    counts[1]++;
+                }
+            }
+        }
+        else if (lines) {
+            for (p = buf; (p = memchr(p, '\n', buf + n - p)) != NULL; p++)
+                counts[0]++;
+        }
+    }
+    free(buf);
+    if (n < 0)
+        return failed("wc", NULL, EXIT_FAILURE);
+
+    /* As wc prints counts of stdin: unpadded if there is only one */
+    fields = lines + words + bytes;
+    for (i = 0; i < 3; i++) {
+        if ((i == 0 && !lines) || (i == 1 && !words) || (i == 2 && !bytes))
+            continue;
+        len += snprintf(msg + len, sizeof(msg) - len, "%s%*lld",
+                        len > 0 ? " " : "", fields == 1 ? 0 : 7, counts[i]);
+    }
+    msg[len++] = '\n';
+
+    return write_all(out, msg, len) < 0 ?
+        failed("wc", NULL, EXIT_FAILURE) : EXIT_SUCCESS;
+}
+/*---------------------------------------------------------------------------*/
+/* Parse the arguments of grep; return TRUE if the pattern is a fixed
+   string and every option is one of -F, -v, -c and -q. */
+static int grep_args(int argc, char *argv[], int *invert, int *count,
+                     int *quiet, const char **pattern) {
+    int i, fixed = FALSE;
+    const char *p;
+
+    *invert = *count = *quiet = FALSE;
+    for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+        for (p = argv[i] + 1; *p != '\0'; p++) {
+            if (*p == 'F')
+                fixed = TRUE;
+            else if (*p == 'v')
+                *invert = TRUE;
+            else if (*p == 'c')
+                *count = TRUE;
+            else if (*p == 'q')
+                *quiet = TRUE;
+            else
+                return FALSE;
+        }
+    }
+    if (i != argc - 1)
+        return FALSE;
+
+    /* A pattern is matched within one line */
+    *pattern = argv[i];
+    if (strchr(*pattern, '\n') != NULL)
+        return FALSE;
+    return fixed || strpbrk(*pattern, ".[]*^$\\") == NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* What grep is looking for and what it found so far */
+struct Grep {
+    const char *pattern;
+    size_t plen;
+    int invert, count, quiet;
+    long long matches;
+    struct Output *o;
+};
+/*---------------------------------------------------------------------------*/
+static long long count_lines(const char *p, const char *end) {
+    long long n = 0;
+
+    for (; (p = memchr(p, '\n', end - p)) != NULL; p++)
+        n++;
+
+    return n;
+}
+/*---------------------------------------------------------------------------*/
+/* Select among the lines from p to end, which is just past a newline.
+   The pattern is searched for across the whole span, not line by
+   line, so lines that cannot match cost nothing.  Return -1 if output
+   failed. */
+static int grep_lines(struct Grep *g, const char *p, const char *end) {
+    const char *m, *start, *stop;
+    int out = !g->count && !g->quiet;
+
+    while (p < end && !(g->quiet && g->matches > 0)) {
+        m = memmem(p, end - p, g->pattern, g->plen);
+        if (m == NULL) {
+            start = stop = end;
+        }
+        else {
+            start = memrchr(p, '\n', m - p);
+            start = (start == NULL) ? p : start + 1;
+            stop = (const char *)memchr(m, '\n', end - m) + 1;
+        }
+
+        /* Lines from p to start do not match; start to stop does */
+        if (g->invert) {
+            g->matches += count_lines(p, start);
+            if (out && out_put(g->o, p, start - p) < 0)
+                return -1;
+        }
+        else if (m != NULL) {
+            g->matches++;
+            if (out && out_put(g->o, start, stop - start) < 0)
+                return -1;
+        }
+        p = stop;
+    }
+
+    return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int grep_main(int argc, char *argv[], int in, int out) {
+    struct Grep g;
+    char *buf, *carry = NULL, *grown, *nl, msg[32];
+    size_t carry_len = 0, len;
+    int error = FALSE;
+    ssize_t n = 0;
+
+    grep_args(argc, argv, &g.invert, &g.count, &g.quiet, &g.pattern);
+    g.plen = strlen(g.pattern);
+    g.matches = 0;
+    buf = malloc(BUF_SIZE);
+    g.o = malloc(sizeof(struct Output));
+    if (buf == NULL || g.o == NULL) {
+        free(buf);
+        free(g.o);
+        return failed("grep", NULL, 2);
+    }
+    g.o->fd = out;
+    g.o->len = 0;
+
+    while (!error && !(g.quiet && g.matches > 0) &&
+           (n = read_some(in, buf, BUF_SIZE)) > 0) {
+        /* A line split across reads is put together in carry */
+        nl = memchr(buf, '\n', n);
+        len = (nl == NULL) ? (size_t)n : (size_t)(nl + 1 - buf);
+        if (carry_len > 0 || nl == NULL) {
+            grown = realloc(carry, carry_len + len + 1);
+            if (grown == NULL) {
+                error = TRUE;
+                break;
+            }
+            carry = grown;
+            memcpy(carry + carry_len, buf, len);
+            carry_len += len;
+            if (nl == NULL)
+                continue;
+            error = grep_lines(&g, carry, carry + carry_len) < 0;
+            carry_len = 0;
+        }
+        else
+            len = 0;
+
+        /* Then every whole line, and the start of the next */
+        nl = memrchr(buf + len, '\n', n - len);
+        if (nl != NULL && !error)
+            error = grep_lines(&g, buf + len, nl + 1) < 0;
+        else
+            nl = buf + len - 1;
+        if (buf + n > nl + 1) {
+            grown = realloc(carry, buf + n - (nl + 1) + 1);
+            if (grown == NULL) {
+                error = TRUE;
+                break;
+            }
+            carry = grown;
+            carry_len = buf + n - (nl + 1);
+            memcpy(carry, nl + 1, carry_len);
+        }
+    }
+
+    /* A last line without a newline gets one, as grep does */
+    if (!error && n >= 0 && carry_len > 0) {
+        carry[carry_len++] = '\n';
+        error = grep_lines(&g, carry, carry + carry_len) < 0;
+    }
+    if (!error && g.count) {
+        snprintf(msg, sizeof(msg), "%lld\n", g.matches);
+        error = out_put(g.o, msg, strlen(msg)) < 0;
+    }
+    if (!error && out_flush(g.o) < 0)
+        error = TRUE;
+
+    free(carry);
+    free(buf);
+    free(g.o);
+    if (error || n < 0)
+        return failed("grep", NULL, 2);
+
+    return g.matches > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+/*---------------------------------------------------------------------------*/
+FilterFn filter_find(int cnt, char *args[]) {
+    int a, b, c;
+    long long count;
+    const char *pattern;
+
+    if (strcmp(args[0], "cat") == 0) {
+        for (a = 1; a < cnt; a++)
+            if (args[a][0] == '-' && args[a][1] != '\0')
+                return NULL;
+        return cat_main;
+    }
+    if (strcmp(args[0], "head") == 0)
+        return head_args(cnt, args, &count, &a) ? head_main : NULL;
+    if (strcmp(args[0], "wc") == 0)
+        return wc_args(cnt, args, &a, &b, &c) ? wc_main : NULL;
+    if (strcmp(args[0], "grep") == 0)
+        return grep_args(cnt, args, &a, &b, &c, &pattern) ? grep_main : NULL;
+
+    return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void *stage_main(void *arg) {
+    struct Stage *s = arg;
+
+    s->status = s->fn(s->argc, s->argv, s->in, s->out);
+
+    /* Let the neighbours see end of file or a closed pipe */
+    close(s->in);
+    close(s->out);
+
+    return NULL;
+}
+/*---------------------------------------------------------------------------*/
+int filter_run(const struct CommandInfo *stages, int cnt, int in, int out,
+               int *statuses) {
+    struct Stage *s;
+    int i, fds[2], next_in = in;
+
+    /* A stage whose reader is gone gets EPIPE and stops, instead of
+       SIGPIPE killing every stage */
+    signal(SIGPIPE, SIG_IGN);
+
+    s = calloc(cnt, sizeof(struct Stage));
+    if (s == NULL) {
+        error_print(NULL, PERROR);
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < cnt; i++) {
+        s[i].fn = stages[i].filter;
+        s[i].argc = stages[i].cnt;
+        s[i].argv = stages[i].args;
+        s[i].in = next_in;
+        s[i].out = out;
+        if (i < cnt - 1) {
+            if (pipe2(fds, O_CLOEXEC) < 0) {
+                error_print(NULL, PERROR);
+                fds[0] = fds[1] = -1;
+            }
+            else
+                pipebuf_apply(fds[1], INNER_PIPE_SIZE);
+            s[i].out = fds[1];
+            next_in = fds[0];
+        }
+    }
+
+    /* The last stage runs on this thread.  A stage that cannot be
+       started closes its descriptors, so the others still finish. */
+    for (i = 0; i < cnt - 1; i++) {
+        if (s[i].in < 0 || s[i].out < 0 ||
+            pthread_create(&s[i].tid, NULL, stage_main, &s[i]) != 0) {
+            error_print("Cannot start a filter thread", FPRINTF);
+            s[i].status = EXIT_FAILURE;
+            s[i].fn = NULL;
+            close(s[i].in);
+            close(s[i].out);
+        }
+    }
+    if (s[cnt - 1].in >= 0)
+        stage_main(&s[cnt - 1]);
+    else {
+        s[cnt - 1].status = EXIT_FAILURE;
+        close(s[cnt - 1].out);
+    }
+
+    for (i = 0; i < cnt; i++) {
+        if (i < cnt - 1 && s[i].fn != NULL)
+            pthread_join(s[i].tid, NULL);
+        statuses[i] = s[i].status;
+    }
+    i = s[cnt - 1].status;
+    free(s);
+
+    return i;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,51 @@
+/*---------------------------------------------------------------------------*/
+/* filter.h                                                                  */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#ifndef _FILTER_H_
+#define _FILTER_H_
+
+#include "plan.h"
+
+/* The shell has its own streaming versions of a few filters that
+   pipelines use all the time: cat, head, wc and grep with a fixed
+   string.  Consecutive pipeline stages that are all such filters are
+   run by one forked helper process, one thread per stage, instead of a
+   fork and an exec each; the threads are connected to each other by
+   pipes, and to the rest of the pipeline through the helper's stdin
+   and stdout like any stage.  cat and head -c move data with splice(2)
+   where the descriptors allow it.
+
+   Only the options listed below are handled natively; a stage that
+   uses any other option, or names files where only stdin is
+   supported, runs the real command.
+     cat [file...]
+     head [-n <lines> | -<lines> | -c <bytes>]
+     wc [-lwc]
+     grep [-Fvcq] <string>    (a pattern without regex characters
+                               unless -F is given)
+   "set +o native" turns native filters off. */
+
+typedef int (*FilterFn)(int argc, char *argv[], int in, int out);
+
+/* A helper runs at most this many stages, since each one past the
+   first costs it a pipe; a longer run is split among several helpers
+   so the descriptors stay well under the usual limit of 1024. */
+enum {FILTER_MAX_RUN = 64};
+
+/* Nonzero when "set -o native" is in effect, as it is by default */
+extern int native_filters;
+
+/* Return the native version of the command args (cnt words), or NULL
+   if there is none for these arguments. */
+FilterFn filter_find(int cnt, char *args[]);
+
+/* Run the cnt stages, whose filters must all be set, as threads:
+   the first reads in, the last writes out, and all of them close the
+   descriptors they were given.  Store each stage's exit status in
+   statuses and return the last one. */
+int filter_run(const struct CommandInfo *stages, int cnt, int in, int out,
+               int *statuses);
+
+#endif /* _FILTER_H_ */
@@ -0,0 +1,381 @@
+/*---------------------------------------------------------------------------*/
+/* jobs.c                                                                    */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jobs.h"
+#include "rusage.h"
+#include "trace.h"
+
+enum {MIN_BUCKETS = 64};
+
+/* Reported groups kept for the jobs listing until it shows them */
+enum {MAX_KEPT = 64};
+
+struct JobProc {
+    pid_t pid;
+
+    /* Command name for the jobs listing */
+    char *cmd;
+
+    struct JobGroup *group;
+
+    /* Chain in the pid table */
+    struct JobProc *hash_next;
+
+    /* Other members of the same group, in launch order */
+    struct JobProc *prev;
+    struct JobProc *next;
+};
+
+struct JobGroup {
+    pid_t pgid;
+
+    /* Command names of all members, joined by " | " */
+    char *cmd;
+
+    /* Members that have not been reaped */
+    int live;
+    struct JobProc *first;
+    struct JobProc *last;
+
+    /* Resource usage of the reaped members, and the wall time from
+       launch until the last one was reaped */
+    struct timespec start;
+    struct rusage usage;
+    double real;
+
+    /* Chain in the pgid table, or in the done or kept queue once
+       finished */
+    struct JobGroup *hash_next;
+
+    /* Other running groups, in launch order */
+    struct JobGroup *prev;
+    struct JobGroup *next;
+};
+
+/* Running processes by pid and running groups by pgid */
+static struct JobProc **pid_table;
+static size_t pid_bucket_cnt;
+static int proc_cnt;
+
+static struct JobGroup **pgid_table;
+static size_t pgid_bucket_cnt;
+static int group_cnt;
+
+static struct JobGroup *oldest;
+static struct JobGroup *newest;
+
+/* Finished groups waiting for jobs_report() */
+static struct JobGroup *done_first;
+static struct JobGroup *done_last;
+
+/* Reported groups waiting for jobs_print() */
+static struct JobGroup *kept_first;
+static struct JobGroup *kept_last;
+static int kept_cnt;
+
+/*---------------------------------------------------------------------------*/
+static size_t slot(pid_t id, size_t bucket_cnt) {
+    /* Pids are handed out sequentially, so the low bits spread well */
+    return (size_t)id & (bucket_cnt - 1);
+}
+/*---------------------------------------------------------------------------*/
+static int grow_pid_table(void) {
+    size_t i, n = pid_bucket_cnt > 0 ? pid_bucket_cnt * 2 : MIN_BUCKETS;
+    struct JobProc **table, *p, *next;
+
+    table = calloc(n, sizeof(struct JobProc *));
+    if (table == NULL)
+        return -1;
+
+    for (i = 0; i < pid_bucket_cnt; i++) {
+        for (p = pid_table[i]; p != NULL; p = next) {
+            next = p->hash_next;
+            p->hash_next = table[slot(p->pid, n)];
+            table[slot(p->pid, n)] = p;
+        }
+    }
+
+    free(pid_table);
+    pid_table = table;
+    pid_bucket_cnt = n;
+
+    return 0;
+}
+/*---------------------------------------------------------------------------*/
+static int grow_pgid_table(void) {
+    size_t i, n = pgid_bucket_cnt > 0 ? pgid_bucket_cnt * 2 : MIN_BUCKETS;
+    struct JobGroup **table, *g, *next;
+
+    table = calloc(n, sizeof(struct JobGroup *));
+    if (table == NULL)
+        return -1;
+
+    for (i = 0; i < pgid_bucket_cnt; i++) {
+        for (g = pgid_table[i]; g != NULL; g = next) {
+            next = g->hash_next;
+            g->hash_next = table[slot(g->pgid, n)];
+            table[slot(g->pgid, n)] = g;
+        }
+    }
+
+    free(pgid_table);
+    pgid_table = table;
+    pgid_bucket_cnt = n;
+
+    return 0;
+}
+/*---------------------------------------------------------------------------*/
+static struct JobGroup *new_group(pid_t pgid) {
+    struct JobGroup *g;
+    size_t i;
+
+    g = calloc(1, sizeof(struct JobGroup));
+    if (g == NULL)
+        return NULL;
+    g->pgid = pgid;
+    clock_gettime(CLOCK_MONOTONIC, &g->start);
+
+    i = slot(pgid, pgid_bucket_cnt);
+    g->hash_next = pgid_table[i];
+    pgid_table[i] = g;
+    group_cnt++;
+
+    g->prev = newest;
+    if (newest != NULL)
+        newest->next = g;
+    else
+        oldest = g;
+    newest = g;
+
+    return g;
+}
+/*---------------------------------------------------------------------------*/
+/* Add cmd to the command line of g.  The listing only loses a name if
+   insufficient memory is available. */
+static void append_cmd(struct JobGroup *g, const char *cmd) {
+    size_t len = g->cmd != NULL ? strlen(g->cmd) : 0;
+    char *joined;
+
+    joined = realloc(g->cmd, len + strlen(cmd) + 4);
+    if (joined == NULL)
+        return;
+
+    if (len > 0)
+        strcpy(joined + len, " | ");
+    else
+        joined[0] = '\0';
+    strcat(joined + len, cmd);
+    g->cmd = joined;
+}
+/*---------------------------------------------------------------------------*/
+static void free_group(struct JobGroup *g) {
+    free(g->cmd);
+    free(g);
+}
+/*---------------------------------------------------------------------------*/
+int jobs_add(pid_t pid, pid_t pgid, const char *cmd) {
+    struct JobProc *p;
+    struct JobGroup *g;
+    size_t i;
+
+    if (proc_cnt >= (int)pid_bucket_cnt && grow_pid_table() < 0)
+        return -1;
+    if (group_cnt >= (int)pgid_bucket_cnt && grow_pgid_table() < 0)
+        return -1;
+
+    p = calloc(1, sizeof(struct JobProc));
+    if (p == NULL)
+        return -1;
+    p->pid = pid;
+    p->cmd = strdup(cmd);
+    if (p->cmd == NULL) {
+        free(p);
+        return -1;
+    }
+
+    for (g = pgid_table[slot(pgid, pgid_bucket_cnt)]; g != NULL;
+         g = g->hash_next)
+        if (g->pgid == pgid)
+            break;
+
+    if (g == NULL && (g = new_group(pgid)) == NULL) {
+        free(p->cmd);
+        free(p);
+        return -1;
+    }
+    append_cmd(g, cmd);
+
+    p->group = g;
+    p->prev = g->last;
+    if (g->last != NULL)
+        g->last->next = p;
+    else
+        g->first = p;
+    g->last = p;
+    g->live++;
+
+    i = slot(pid, pid_bucket_cnt);
+    p->hash_next = pid_table[i];
+    pid_table[i] = p;
+    proc_cnt++;
+
+    return 0;
+}
+/*---------------------------------------------------------------------------*/
+int jobs_reap(pid_t pid, const struct rusage *usage) {
+    struct JobProc **pp, *p;
+    struct JobGroup **gp, *g;
+
+    if (pid_bucket_cnt == 0)
+        return 0;
+
+    for (pp = &pid_table[slot(pid, pid_bucket_cnt)]; *pp != NULL;
+         pp = &(*pp)->hash_next)
+        if ((*pp)->pid == pid)
+            break;
+    if (*pp == NULL)
+        return 0;
+
+    p = *pp;
+    *pp = p->hash_next;
+    proc_cnt--;
+
+    g = p->group;
+    if (p->prev != NULL)
+        p->prev->next = p->next;
+    else
+        g->first = p->next;
+    if (p->next != NULL)
+        p->next->prev = p->prev;
+    else
+        g->last = p->prev;
+
+    free(p->cmd);
+    free(p);
+
+    rusage_add(&g->usage, usage);
+    if (--g->live > 0)
+        return 1;
+    g->real = rusage_since(&g->start);
+    trace_instant("job done", 0, g->pgid, g->cmd);
+
+    /* The whole group is done: move it to the done queue */
+    for (gp = &pgid_table[slot(g->pgid, pgid_bucket_cnt)]; *gp != g;
+         gp = &(*gp)->hash_next)
+        ;
+    *gp = g->hash_next;
+    group_cnt--;
+
+    if (g->prev != NULL)
+        g->prev->next = g->next;
+    else
+        oldest = g->next;
+    if (g->next != NULL)
+        g->next->prev = g->prev;
+    else
+        newest = g->prev;
+
+    g->hash_next = NULL;
+    if (done_last != NULL)
+        done_last->hash_next = g;
+    else
+        done_first = g;
+    done_last = g;
+
+    return 1;
+}
+/*---------------------------------------------------------------------------*/
+int jobs_finished(void) {
+    return done_first != NULL;
+}
+/*---------------------------------------------------------------------------*/
+int jobs_report(void) {
+    struct JobGroup *g;
+    int cnt = 0;
+
+    while ((g = done_first) != NULL) {
+        done_first = g->hash_next;
+        printf("[%d] Done background process group\n", g->pgid);
+        cnt++;
+
+        /* Keep it for the jobs listing, dropping the oldest if need be */
+        g->hash_next = NULL;
+        if (kept_last != NULL)
+            kept_last->hash_next = g;
+        else
+            kept_first = g;
+        kept_last = g;
+        if (++kept_cnt > MAX_KEPT) {
+            g = kept_first;
+            kept_first = g->hash_next;
+            free_group(g);
+            kept_cnt--;
+        }
+    }
+    done_last = NULL;
+
+    return cnt;
+}
+/*---------------------------------------------------------------------------*/
+void jobs_print(void) {
+    struct JobGroup *g;
+    struct JobProc *p;
+
+    for (g = oldest; g != NULL; g = g->next)
+        for (p = g->first; p != NULL; p = p->next)
+            printf("[%d] Running\t%s\n", p->pid, p->cmd);
+
+    while ((g = kept_first) != NULL) {
+        kept_first = g->hash_next;
+        printf("[%d] Done\t%s\t", g->pgid, g->cmd != NULL ? g->cmd : "");
+        rusage_print_line(stdout, g->real, &g->usage);
+        printf("\n");
+        free_group(g);
+    }
+    kept_last = NULL;
+    kept_cnt = 0;
+}
+/*---------------------------------------------------------------------------*/
+int jobs_count(void) {
+    return proc_cnt;
+}
+/*---------------------------------------------------------------------------*/
+void jobs_clear(void) {
+    struct JobGroup *g, *next_group;
+    struct JobProc *p, *next;
+
+    for (g = oldest; g != NULL; g = next_group) {
+        next_group = g->next;
+        for (p = g->first; p != NULL; p = next) {
+            next = p->next;
+            free(p->cmd);
+            free(p);
+        }
+        free_group(g);
+    }
+    for (g = done_first; g != NULL; g = next_group) {
+        next_group = g->hash_next;
+        free_group(g);
+    }
+    for (g = kept_first; g != NULL; g = next_group) {
+        next_group = g->hash_next;
+        free_group(g);
+    }
+    free(pid_table);
+    free(pgid_table);
+    pid_table = NULL;
+    pgid_table = NULL;
+    pid_bucket_cnt = pgid_bucket_cnt = 0;
+    proc_cnt = group_cnt = 0;
+    oldest = newest = NULL;
+    done_first = done_last = NULL;
+    kept_first = kept_last = NULL;
+    kept_cnt = 0;
+}
+/*---------------------------------------------------------------------------*/
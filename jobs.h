@@ -0,0 +1,56 @@
+/*---------------------------------------------------------------------------*/
+/* jobs.h                                                                    */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#ifndef _JOBS_H_
+#define _JOBS_H_
+
+#include <sys/types.h>
+#include <sys/resource.h>
+
+/* The job table tracks background processes.  Processes are found by
+   pid and process groups by pgid through hash tables that grow with
+   the number of jobs, and each group counts its members that are still
+   running, so recording a reaped child and noticing that its group has
+   finished take constant time however many jobs there are.
+
+   The table belongs to the main loop; terminated children reach it
+   through the event loop (see evloop.h). */
+
+/* Record background process pid, a member of process group pgid,
+   running cmd.  Return 0 on success or -1 if insufficient memory is
+   available. */
+int jobs_add(pid_t pid, pid_t pgid, const char *cmd);
+
+/* Note that background process pid has terminated, having used the
+   resources in *usage, which count toward its group.  If it was the
+   last running member of its group, queue the group for
+   jobs_report().  Return 1 if pid was a background process, 0 if
+   not. */
+int jobs_reap(pid_t pid, const struct rusage *usage);
+
+/* Return 1 if some group finished and has not been reported yet, 0 if
+   not. */
+int jobs_finished(void);
+
+/* Print "[pgid] Done background process group" for each group that
+   finished since the last call, oldest first, and keep them for
+   jobs_print() (the latest MAX_KEPT of them).  Return the number of
+   groups reported. */
+int jobs_report(void);
+
+/* Print "[pid] Running\tcmd" for each background process that has not
+   terminated, oldest group first.  Then print "[pgid] Done\tcmds\t"
+   and the resource usage of each group reported since the last call,
+   and forget them. */
+void jobs_print(void);
+
+/* Return the number of background processes that have not
+   terminated. */
+int jobs_count(void);
+
+/* Forget every job. */
+void jobs_clear(void);
+
+#endif /* _JOBS_H_ */
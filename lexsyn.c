@@ -1,5 +1,5 @@
 /*---------------------------------------------------------------------------*/
-/* lexsyn.h                                                                  */
+/* lexsyn.c                                                                  */
 /* Author: Jongki Park, Kyoungsoo Park                                       */
 /*---------------------------------------------------------------------------*/
 
@@ -8,27 +8,47 @@
 #include "util.h"
 
 /*---------------------------------------------------------------------------*/
-static int add_to_token_array(DynArray_T oTokens, 
-                            enum TokenType type, char *value) {
-    struct Token *new_token;
-
-    new_token = make_one_token(type, value);
-    if (new_token == NULL) {
+static int add_to_token_array(TokenVec_T oTokens, enum TokenType type,
+                            int offset, int length) {
+    if (!tokvec_add(oTokens, type, offset, length)) {
         error_print("Cannot allocate memory", FPRINTF);
         return FALSE;
     }
 
-    if (!dynarray_add(oTokens, new_token)) {
-        error_print("Cannot allocate memory", FPRINTF);
+    return TRUE;
+}
+/*---------------------------------------------------------------------------*/
+/* Return TRUE and store the token type in *type if c is a character
+   that forms a token of its own. */
+static int is_special(char c, enum TokenType *type) {
+    switch (c) {
+    case '|':
+        *type = TOKEN_PIPE;
+        return TRUE;
+    case '&':
+        *type = TOKEN_BG;
+        return TRUE;
+    case '>':
+        *type = TOKEN_REDOUT;
+        return TRUE;
+    case '<':
+        *type = TOKEN_REDIN;
+        return TRUE;
+    default:
         return FALSE;
     }
-
-    return TRUE;
 }
 /*---------------------------------------------------------------------------*/
-enum LexResult lex_line(const char *c_line, DynArray_T oTokens) {
+enum LexResult lex_line(const char *c_line, TokenVec_T oTokens,
+                        Arena_T oArena) {
 
-    /* It "reads" its characters from c_line. */
+    /* It copies c_line once into oArena and "reads" its characters
+       from the copy.  Word characters are written back into the same
+       buffer (quotes removed) and each word is NUL-terminated where it
+       ends, so no token text is ever copied again.  Writing never
+       overtakes reading: a word starts where its first character is,
+       and its terminator lands at most on the delimiter that was just
+       read. */
 
     enum LexState {
         STATE_START,
@@ -38,143 +58,87 @@ enum LexResult lex_line(const char *c_line, DynArray_T oTokens) {
     };
 
     enum LexState state = STATE_START;
+    enum TokenType type = TOKEN_WORD;
 
-    int command_line_index = 0;
-    int value_index = 0;
+    int read_index = 0;
+    int write_index = 0;
+    int word_start = 0;
+    int len;
+    char *line;
     char c;
-    char c_value[MAX_LINE_SIZE];
 
     assert(c_line != NULL);
     assert(oTokens != NULL);
+    assert(oArena != NULL);
+
+    len = strcspn(c_line, "\n");
+
+    line = arena_alloc(oArena, len + 1);
+    if (line == NULL) {
+        error_print("Cannot allocate memory", FPRINTF);
+        return LEX_NOMEM;
+    }
+    memcpy(line, c_line, len);
+    line[len] = '\0';
+    tokvec_reset(oTokens, line);
 
     for (;;) {
-        if (command_line_index == MAX_LINE_SIZE)
-            return LEX_LONG;
-        
-        /* "Read" the next character from c_line. */
-        c = c_line[command_line_index++];
+        /* "Read" the next character from the line. */
+        c = line[read_index++];
 
         switch (state) {
         case STATE_START:
-            if ((c == '\n') || (c == '\0'))
+            if (c == '\0')
                 return LEX_SUCCESS;
-            else if (isspace(c))
-                state = STATE_START;
-            else if (c == '|') {
-                /* Create a PIPE token. */
-                if (add_to_token_array(oTokens, TOKEN_PIPE, NULL) == FALSE)
-                    return LEX_NOMEM;
-
-                state = STATE_START;
-            }
-            else if (c == '&') {
-                // Create a Background command token.
-                if (add_to_token_array(oTokens, TOKEN_BG, NULL) == FALSE)
-                    return LEX_NOMEM;
-
+            else if (isspace((unsigned char)c))
                 state = STATE_START;
-            }
-            else if (c == '>') {
-                /* Create a REDOUT token. */
-                if (add_to_token_array(oTokens, TOKEN_REDOUT, NULL) == FALSE)
-                    return LEX_NOMEM;
-
-                state = STATE_START;
-            }
-            else if (c == '<') {
-                /* Create a PIPE token. */
-                if (add_to_token_array(oTokens, TOKEN_REDIN, NULL) == FALSE)
+            else if (is_special(c, &type)) {
+                /* Create a PIPE, FANOUT, BG, REDOUT or REDIN token. */
+                if (c == '|' && line[read_index] == '+') {
+                    type = TOKEN_FANOUT;
+                    read_index++;
+                }
+                if (add_to_token_array(oTokens, type, read_index - 1, 0)
+                    == FALSE)
                     return LEX_NOMEM;
 
                 state = STATE_START;
             }
-            else if (c == '\"') {
-                state = STATE_IN_DQUOTE;
-            }
-            else if (c == '\'') {
-                state = STATE_IN_QUOTE;
-            }
             else {
-                c_value[value_index++] = c;
-                state = STATE_IN_WORD;
+                word_start = write_index = read_index - 1;
+                if (c == '\"')
+                    state = STATE_IN_DQUOTE;
+                else if (c == '\'')
+                    state = STATE_IN_QUOTE;
+                else {
+                    line[write_index++] = c;
+                    state = STATE_IN_WORD;
+                }
             }
             break;
 
         case STATE_IN_WORD:
-            if ((c == '\n') || (c == '\0')) {
+            if ((c == '\0') || isspace((unsigned char)c) ||
+                is_special(c, &type)) {
                 /* Create a WORD token. */
-                c_value[value_index] = '\0';
-                if (add_to_token_array(oTokens, TOKEN_WORD, c_value) == FALSE)
+                line[write_index] = '\0';
+                if (add_to_token_array(oTokens, TOKEN_WORD, word_start,
+                                       write_index - word_start) == FALSE)
                     return LEX_NOMEM;
 
-                value_index = 0;
+                if (c == '\0')
+                    return LEX_SUCCESS;
 
-                return LEX_SUCCESS;
-            }
-            else if (isspace(c)) {
-                /* Create a WORD token. */
-                c_value[value_index] = '\0';
-                if (add_to_token_array(oTokens, TOKEN_WORD, c_value) == FALSE)
-                    return LEX_NOMEM;
-
-                value_index = 0;
-
-                state = STATE_START;
-            }
-            else if (c == '|') {
-                /* Create a WORD token. */
-                c_value[value_index] = '\0';
-                if (add_to_token_array(oTokens, TOKEN_WORD, c_value) == FALSE)
-                    return LEX_NOMEM;
-
-                /* Create a PIPE token. */
-                if (add_to_token_array(oTokens, TOKEN_PIPE, NULL) == FALSE)
-                    return LEX_NOMEM;
-
-                value_index = 0;
-
-                state = STATE_START;
-            }
-            else if (c == '>') {
-                /* Create a WORD token. */
-                c_value[value_index] = '\0';
-                if (add_to_token_array(oTokens, TOKEN_WORD, c_value) == FALSE)
-                    return LEX_NOMEM;
-
-                /* Create a REDOUT token. */
-                if (add_to_token_array(oTokens, TOKEN_REDOUT, NULL) == FALSE)
-                    return LEX_NOMEM;
-
-                value_index = 0;
-
-                state = STATE_START;
-            }
-            else if (c == '<') {
-                /* Create a WORD token. */
-                c_value[value_index] = '\0';
-                if (add_to_token_array(oTokens, TOKEN_WORD, c_value) == FALSE)
-                    return LEX_NOMEM;
-
-                /* Create a REDIN token. */
-                if (add_to_token_array(oTokens, TOKEN_REDIN, NULL) == FALSE)
-                    return LEX_NOMEM;
-
-                value_index = 0;
-
-                state = STATE_START;
-            }
-            else if (c == '&') {
-                // Create a WORD token
-
-                c_value[value_index] = '\0';
-                if (add_to_token_array(oTokens, TOKEN_WORD, c_value) == FALSE)
-                    return LEX_NOMEM;
-
-                // Create a Background command token.
-                if (add_to_token_array(oTokens, TOKEN_BG, NULL) == FALSE)
+                /* The delimiter may be a token of its own. */
+                if (c == '|' && line[read_index] == '+') {
+                    type = TOKEN_FANOUT;
+                    read_index++;
+                }
+                if (!isspace((unsigned char)c) &&
+                    add_to_token_array(oTokens, type, read_index - 1, 0)
+                    == FALSE)
                     return LEX_NOMEM;
 
-                value_index = 0;
                 state = STATE_START;
             }
             else if (c == '\"') {
@@ -184,7 +148,7 @@ enum LexResult lex_line(const char *c_line, DynArray_T oTokens) {
                 state = STATE_IN_QUOTE;
             }
             else {
-                c_value[value_index++] = c;
+                line[write_index++] = c;
                 state = STATE_IN_WORD;
             }
             break;
@@ -192,20 +156,20 @@ enum LexResult lex_line(const char *c_line, DynArray_T oTokens) {
         case STATE_IN_DQUOTE:
             if (c == '\"')
                 state = STATE_IN_WORD;
-            else if ((c == '\n') || (c == '\0'))
+            else if (c == '\0')
                 return LEX_QERROR;
             else
-                c_value[value_index++] = c;
+                line[write_index++] = c;
 
             break;
 
         case STATE_IN_QUOTE:
             if (c == '\'')
                 state = STATE_IN_WORD;
-            else if ((c == '\n') || (c == '\0'))
+            else if (c == '\0')
                 return LEX_QERROR;
             else
-                c_value[value_index++] = c;
+                line[write_index++] = c;
             break;
 
         default:
@@ -214,16 +178,17 @@ enum LexResult lex_line(const char *c_line, DynArray_T oTokens) {
     }
 }
 /*---------------------------------------------------------------------------*/
-enum SyntaxResult syntax_check(DynArray_T oTokens) {
+enum SyntaxResult syntax_check(TokenVec_T oTokens) {
     int i;
     enum SyntaxResult ret = SYN_SUCCESS;
     int ri_exist = FALSE, ro_exist = FALSE, p_exist = FALSE;
+    int f_exist = FALSE;
     struct Token *t_curr, *t_next;
 
     assert(oTokens);
 
-    for (i = 0; i < dynarray_get_length(oTokens); i++) {
-        t_curr = dynarray_get(oTokens, i);
+    for (i = 0; i < tokvec_get_length(oTokens); i++) {
+        t_curr = tokvec_get(oTokens, i);
         if (i == 0) {
             if (t_curr->token_type != TOKEN_WORD) {
                 /* Missing command name */
@@ -232,22 +197,28 @@ enum SyntaxResult syntax_check(DynArray_T oTokens) {
             }
         }
         else {
-            if (t_curr->token_type == TOKEN_PIPE) {
+            if (t_curr->token_type == TOKEN_PIPE ||
+                t_curr->token_type == TOKEN_FANOUT) {
                 /* No redout in previous tokens and 
-                    no consecutive pipe in following tokens */
+                    no consecutive pipe in following tokens.
+                    Each branch after a "|+" may end in a redout of
+                    its own, but what is fanned out may not. */
+                if (t_curr->token_type == TOKEN_FANOUT &&
+                    f_exist == TRUE)
+                    ro_exist = FALSE;
                 if (ro_exist == TRUE) {
                     /* Multiple redirection error */
                     ret = SYN_FAIL_MULTREDOUT;
                     break;
                 }
                 else {
-                    if (i == dynarray_get_length(oTokens) - 1) {
+                    if (i == tokvec_get_length(oTokens) - 1) {
                         /* Redirection without destination */
                         ret = SYN_FAIL_NOCMD;
                         break;
                     }
                     else {
-                        t_next = dynarray_get(oTokens, i + 1);
+                        t_next = tokvec_get(oTokens, i + 1);
                         if (t_next->token_type != TOKEN_WORD) {
                             /* Redirection without destination */
                             ret = SYN_FAIL_NOCMD;
@@ -255,10 +226,12 @@ enum SyntaxResult syntax_check(DynArray_T oTokens) {
                         }
                     }
                     p_exist = TRUE;
+                    if (t_curr->token_type == TOKEN_FANOUT)
+                        f_exist = TRUE;
                 }
             }
             else if (t_curr->token_type == TOKEN_BG) {
-                if (i != dynarray_get_length(oTokens) - 1) {
+                if (i != tokvec_get_length(oTokens) - 1) {
                     ret = SYN_FAIL_INVALIDBG;
                     break;
                 }
@@ -272,13 +245,13 @@ enum SyntaxResult syntax_check(DynArray_T oTokens) {
                     break;
                 }
                 else {
-                    if (i == dynarray_get_length(oTokens) - 1) {
+                    if (i == tokvec_get_length(oTokens) - 1) {
                         /* Redirection without destination */
                         ret = SYN_FAIL_NODESTIN;
                         break;
                     }
                     else {
-                        t_next = dynarray_get(oTokens, i + 1);
+                        t_next = tokvec_get(oTokens, i + 1);
                         if (t_next->token_type != TOKEN_WORD) {
                             /* Redirection without destination */
                             ret = SYN_FAIL_NODESTIN;
@@ -296,13 +269,13 @@ enum SyntaxResult syntax_check(DynArray_T oTokens) {
                     break;
                 }
                 else {
-                    if (i == dynarray_get_length(oTokens) - 1) {
+                    if (i == tokvec_get_length(oTokens) - 1) {
                         /* Redirection without destination */
                         ret = SYN_FAIL_NODESTOUT;
                         break;
                     }
                     else {
-                        t_next = dynarray_get(oTokens, i + 1);
+                        t_next = tokvec_get(oTokens, i + 1);
                         if (t_next->token_type != TOKEN_WORD) {
                             /* Redirection without destination */
                             ret = SYN_FAIL_NODESTOUT;
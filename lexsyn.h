@@ -11,12 +11,12 @@
 #include <stdlib.h>
 #include <assert.h>
 
-#include "dynarray.h"
+#include "token.h"
+#include "arena.h"
 
-enum {MAX_LINE_SIZE = 1024};
 enum {MAX_ARGS_CNT = 64};
 
-enum LexResult {LEX_SUCCESS, LEX_QERROR, LEX_NOMEM, LEX_LONG};
+enum LexResult {LEX_SUCCESS, LEX_QERROR, LEX_NOMEM};
 enum SyntaxResult {
   SYN_SUCCESS,
   SYN_FAIL_NOCMD,
@@ -28,8 +28,8 @@ enum SyntaxResult {
 };
 
 // void command_lexLine(const char * c_line, DynArray_T ctokens);
-enum LexResult lexLine_quote(const char *c_line, DynArray_T oTokens);
-enum LexResult lex_line(const char *c_line, DynArray_T oTokens);
-enum SyntaxResult syntax_check(DynArray_T oTokens);
+enum LexResult lex_line(const char *c_line, TokenVec_T oTokens,
+                        Arena_T oArena);
+enum SyntaxResult syntax_check(TokenVec_T oTokens);
 
 #endif /* _LEXSYN_H */
\ No newline at end of file
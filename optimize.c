@@ -0,0 +1,193 @@
+/*---------------------------------------------------------------------------*/
+/* optimize.c                                                                */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "optimize.h"
+#include "util.h"
+
+int optimize_lines;
+
+/* One stage of the line, by token index */
+struct Stage {
+    int begin, end;     /* Its tokens, the '|' after it excluded */
+    int words;          /* Number of arguments, the command included */
+    int cmd;            /* The command name */
+    int redin, redout;  /* The redirection's file, or -1 */
+    int dropped;
+};
+
+/*---------------------------------------------------------------------------*/
+/* Return TRUE if the stage is cat with no argument but maybe a file to
+   read. */
+static int is_cat(TokenVec_T oTokens, const struct Stage *s, int args) {
+    const char *arg;
+
+    if (s->dropped || s->words != 1 + args ||
+        strcmp(tokvec_get_value(oTokens, s->cmd), "cat") != 0)
+        return FALSE;
+    if (args == 0)
+        return TRUE;
+
+    /* The argument is the word after the command */
+    if (s->cmd + 1 >= s->end)
+        return FALSE;
+    arg = tokvec_get_value(oTokens, s->cmd + 1);
+    return arg != NULL && arg[0] != '-' &&
+        s->cmd + 1 != s->redin && s->cmd + 1 != s->redout;
+}
+/*---------------------------------------------------------------------------*/
+static int stdout_is_file(void) {
+    struct stat st;
+
+    return fstat(STDOUT_FILENO, &st) == 0 && S_ISREG(st.st_mode);
+}
+/*---------------------------------------------------------------------------*/
+/* Split the line into stages; return how many there are */
+static int split(TokenVec_T oTokens, struct Stage *stages) {
+    int i, cnt = 0, len = tokvec_get_length(oTokens);
+    enum TokenType type;
+    struct Stage *s = &stages[0];
+
+    memset(s, 0, sizeof(*s));
+    s->redin = s->redout = s->cmd = -1;
+    for (i = 0; i < len; i++) {
+        type = tokvec_get(oTokens, i)->token_type;
+        if (type == TOKEN_PIPE || type == TOKEN_BG) {
+            s->end = i;
+            if (type == TOKEN_BG)
+                break;
+            s = &stages[++cnt];
+            memset(s, 0, sizeof(*s));
+            s->begin = i + 1;
+            s->redin = s->redout = s->cmd = -1;
+        }
+        else if (type == TOKEN_REDIN)
+            s->redin = ++i;
+        else if (type == TOKEN_REDOUT)
+            s->redout = ++i;
+        else {
+            if (s->cmd < 0)
+                s->cmd = i;
+            s->words++;
+        }
+        s->end = i + 1;
+    }
+
+    return cnt + 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Apply the rules; return the number of stages dropped */
+static int rewrite(TokenVec_T oTokens, struct Stage *stages, int cnt) {
+    int i, prev, first = 0, last = cnt - 1, removed = 0;
+
+    /* cat file | cmd -> cmd < file, as long as cmd is not a builtin
+       that would then see a redirection */
+    while (first < last &&
+           check_builtin(tokvec_get_value(oTokens,
+                                          stages[first + 1].cmd)) == NORMAL &&
+           ((is_cat(oTokens, &stages[first], 1) && stages[first].redin < 0) ||
+            (is_cat(oTokens, &stages[first], 0) &&
+             stages[first].redin >= 0))) {
+        stages[first + 1].redin = stages[first].redin >= 0 ?
+            stages[first].redin : stages[first].cmd + 1;
+        stages[first++].dropped = TRUE;
+        removed++;
+    }
+
+    /* a | cat | b -> a | b, and cat | b -> b */
+    for (i = first; i < last; i++) {
+        if (is_cat(oTokens, &stages[i], 0) && stages[i].redin < 0) {
+            stages[i].dropped = TRUE;
+            removed++;
+        }
+    }
+
+    /* cmd | cat > out -> cmd > out, and cmd | cat -> cmd if that
+       writes to a file anyway */
+    for (prev = last - 1; prev >= 0 && stages[prev].dropped; prev--)
+        ;
+    if (prev >= 0 && is_cat(oTokens, &stages[last], 0) &&
+        stages[last].redin < 0 &&
+        (stages[last].redout >= 0 || stdout_is_file())) {
+        stages[prev].redout = stages[last].redout;
+        stages[last].dropped = TRUE;
+        removed++;
+    }
+
+    return removed;
+}
+/*---------------------------------------------------------------------------*/
+int optimize_tokens(TokenVec_T oTokens, Arena_T oArena) {
+    int i, j, n = 0, cnt, removed, len = tokvec_get_length(oTokens);
+    struct Token *out, *t, bar = {TOKEN_PIPE, 0, 0};
+    struct Token redin = {TOKEN_REDIN, 0, 0}, redout = {TOKEN_REDOUT, 0, 0};
+    struct Stage *stages, *s;
+    int background;
+
+    /* Fan-out lines are left as they are */
+    for (i = 0; i < len; i++) {
+        if (tokvec_get(oTokens, i)->token_type == TOKEN_FANOUT)
+            return 0;
+    }
+
+    /* A checked line has at most len / 2 + 1 stages */
+    stages = arena_alloc(oArena, sizeof(struct Stage) * (len / 2 + 1));
+    out = arena_alloc(oArena, sizeof(struct Token) * len);
+    if (stages == NULL || out == NULL)
+        return -1;
+
+    cnt = split(oTokens, stages);
+    removed = rewrite(oTokens, stages, cnt);
+    if (removed == 0)
+        return 0;
+
+    /* Lay the stages that are left out again: words, then redirections.
+       No stage grows, so neither does the line. */
+    background = tokvec_get(oTokens, len - 1)->token_type == TOKEN_BG;
+    for (i = 0; i < cnt; i++) {
+        s = &stages[i];
+        if (s->dropped)
+            continue;
+        if (n > 0)
+            out[n++] = bar;
+
+        for (j = s->begin; j < s->end; j++) {
+            t = tokvec_get(oTokens, j);
+            if (t->token_type == TOKEN_REDIN || t->token_type == TOKEN_REDOUT)
+                j++;
+            else
+                out[n++] = *t;
+        }
+        if (s->redin >= 0) {
+            out[n++] = redin;
+            out[n++] = *tokvec_get(oTokens, s->redin);
+        }
+        if (s->redout >= 0) {
+            out[n++] = redout;
+            out[n++] = *tokvec_get(oTokens, s->redout);
+        }
+    }
+    if (background)
+        out[n++] = *tokvec_get(oTokens, len - 1);
+
+    tokvec_reset(oTokens, oTokens->line);
+    for (i = 0; i < n; i++)
+        tokvec_add(oTokens, out[i].token_type, out[i].token_offset,
+                   out[i].token_length);
+
+    if (getenv("DEBUG") != NULL) {
+        fprintf(stderr, "optimized: %d stage%s removed\n",
+                removed, removed == 1 ? "" : "s");
+        dump_lex(oTokens);
+    }
+
+    return removed;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,36 @@
+/*---------------------------------------------------------------------------*/
+/* optimize.h                                                                */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#ifndef _OPTIMIZE_H_
+#define _OPTIMIZE_H_
+
+#include "token.h"
+#include "arena.h"
+
+/* With "set -o optimize", a checked line is rewritten before it is
+   compiled so that no stage is started only to copy its input to its
+   output.  Every stage removed saves a fork, an exec and a pipe copy
+   of the whole data stream.  The rules are:
+
+     cat file | cmd      ->  cmd < file    (also cat < file | cmd)
+     a | cat | b         ->  a | b         (also cat | b -> b)
+     cmd | cat > out     ->  cmd > out
+     cmd | cat           ->  cmd           when stdout is a regular file
+
+   A cat stage qualifies only without options.  The rewritten line
+   has fewer stages, so $PIPESTATUS has fewer entries, and a missing
+   file is reported by the redirection instead of by cat.  The
+   rewritten tokens are shown on stderr when DEBUG is set. */
+
+/* Nonzero when "set -o optimize" is in effect */
+extern int optimize_lines;
+
+/* Rewrite oTokens, which must have passed syntax_check(), by the
+   rules above, using oArena for scratch space.  Return the number of
+   stages removed, or -1 if insufficient memory is available, in which
+   case oTokens is left as it was. */
+int optimize_tokens(TokenVec_T oTokens, Arena_T oArena);
+
+#endif /* _OPTIMIZE_H_ */
@@ -0,0 +1,351 @@
+/*---------------------------------------------------------------------------*/
+/* parallel.c                                                                */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/wait.h>
+
+#include "parallel.h"
+#include "util.h"
+#include "execute.h"
+#include "cmdhash.h"
+#include "evloop.h"
+#include "fdreg.h"
+#include "rusage.h"
+
+/* A job slot; its entry in pids[] is 0 while it is free */
+struct Slot {
+    int num;                /* Jobs are numbered from 1 as they start */
+    char *item;
+    int out, err;           /* Memory files holding its stdout, stderr */
+    struct timespec start;
+};
+
+struct Parallel {
+    char **cmd;             /* The command and its arguments */
+    int cmd_cnt;
+    const char *path;       /* The command's path if it has no "{}" */
+    char **items;           /* The items after ":::", or NULL */
+    int item_cnt, next;
+    FILE *in;               /* Otherwise the items come from here */
+    char *line;
+    size_t line_cap;
+};
+
+/*---------------------------------------------------------------------------*/
+static void parallel_error(const char *what, const char *detail) {
+    char msg[256];
+
+    if (detail != NULL)
+        snprintf(msg, sizeof(msg), "parallel: %s: %s", what, detail);
+    else
+        snprintf(msg, sizeof(msg), "parallel: %s", what);
+    error_print(msg, FPRINTF);
+}
+/*---------------------------------------------------------------------------*/
+/* Return the next item, allocated, or NULL when there are no more */
+static char *next_item(struct Parallel *p) {
+    ssize_t len;
+
+    if (p->items != NULL)
+        return p->next < p->item_cnt ? strdup(p->items[p->next++]) : NULL;
+
+    while ((len = getline(&p->line, &p->line_cap, p->in)) > 0) {
+        if (p->line[len - 1] == '\n')
+            p->line[--len] = '\0';
+        if (len > 0)
+            return strdup(p->line);
+    }
+    return NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Return word with each "{}" replaced with item, allocated */
+static char *expand(const char *word, const char *item) {
+    size_t len = strlen(word), item_len = strlen(item);
+    const char *s, *brace;
+    char *out, *o;
+    int cnt = 0;
+
+    for (s = word; (s = strstr(s, "{}")) != NULL; s += 2)
+        cnt++;
+    out = malloc(len + cnt * item_len + 1);
+    if (out == NULL)
+        return NULL;
+
+    o = out;
+    for (s = word; (brace = strstr(s, "{}")) != NULL; s = brace + 2) {
+        memcpy(o, s, brace - s);
+        o += brace - s;
+        memcpy(o, item, item_len);
+        o += item_len;
+    }
+    strcpy(o, s);
+
+    return out;
+}
+/*---------------------------------------------------------------------------*/
+/* Become the job for item.  Never returns. */
+static void run_job(struct Parallel *p, const char *item, int out, int err) {
+    char **argv;
+    int i, fd, braces = FALSE;
+    sigset_t mask;
+
+    /* Don't leave the shell's SIGINT and SIGCHLD settings to the job */
+    signal(SIGINT, SIG_DFL);
+    signal(SIGQUIT, SIG_DFL);
+    signal(SIGTSTP, SIG_DFL);
+    signal(SIGTTOU, SIG_DFL);
+    signal(SIGCHLD, SIG_DFL);
+    sigemptyset(&mask);
+    sigprocmask(SIG_SETMASK, &mask, NULL);
+
+    if (p->items == NULL && (fd = open("/dev/null", O_RDONLY)) >= 0) {
+        dup2(fd, STDIN_FILENO);
+        close(fd);
+    }
+    dup2(out, STDOUT_FILENO);
+    dup2(err, STDERR_FILENO);
+    fdreg_close_from(3);
+
+    argv = malloc(sizeof(char *) * (p->cmd_cnt + 2));
+    if (argv == NULL) {
+        error_print("Cannot allocate memory", FPRINTF);
+        _exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < p->cmd_cnt; i++) {
+        if (strstr(p->cmd[i], "{}") != NULL)
+            braces = TRUE;
+        argv[i] = expand(p->cmd[i], item);
+        if (argv[i] == NULL) {
+            error_print("Cannot allocate memory", FPRINTF);
+            _exit(EXIT_FAILURE);
+        }
+    }
+    if (!braces)
+        argv[i++] = (char *)item;
+    argv[i] = NULL;
+
+    if (p->path != NULL)
+        execv(p->path, argv);
+    execvp(argv[0], argv);
+    error_print(argv[0], PERROR);
+    _exit(EXIT_EXEC_FAIL);
+}
+/*---------------------------------------------------------------------------*/
+/* Start the job for item in slot s.  Return its pid, or -1 after
+   reporting why it could not be started. */
+static pid_t start_job(struct Parallel *p, struct Slot *s, char *item) {
+    pid_t pid;
+
+    s->item = item;
+    s->out = fdreg_add(memfd_create("parallel-out", MFD_CLOEXEC));
+    s->err = fdreg_add(memfd_create("parallel-err", MFD_CLOEXEC));
+    if (s->out < 0 || s->err < 0) {
+        error_print(NULL, PERROR);
+        return -1;
+    }
+
+    /* The job must not inherit what the shell has buffered */
+    fflush(stdout);
+    clock_gettime(CLOCK_MONOTONIC, &s->start);
+    pid = fork();
+    if (pid == 0)
+        run_job(p, item, s->out, s->err);
+    if (pid < 0) {
+        error_print(NULL, PERROR);
+        return -1;
+    }
+
+    evloop_watch(pid);
+    return pid;
+}
+/*---------------------------------------------------------------------------*/
+/* Write everything in the memory file fd to target */
+static void copy_out(int fd, int target) {
+    char buf[8192];
+    off_t off = 0;
+    ssize_t r;
+
+    while ((r = sendfile(target, fd, &off, 1 << 30)) > 0)
+        ;
+    if (r == 0)
+        return;
+
+    /* sendfile() refuses some targets; copy the rest by hand */
+    lseek(fd, off, SEEK_SET);
+    while ((r = read(fd, buf, sizeof(buf))) > 0) {
+        if (write(target, buf, r) != r)
+            break;
+    }
+}
+/*---------------------------------------------------------------------------*/
+/* Write out the output of the job in s, which has exited with
+   status, and report it.  Return its exit status. */
+static int finish_job(struct Slot *s, int status) {
+    double real = rusage_since(&s->start);
+    int ret;
+
+    ret = WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
+
+    copy_out(s->out, STDOUT_FILENO);
+    copy_out(s->err, STDERR_FILENO);
+    fprintf(stderr, "parallel: [%d] %s: status %d, real %.3fs\n",
+            s->num, s->item, ret, real);
+
+    fdreg_close(s->out);
+    fdreg_close(s->err);
+    free(s->item);
+    s->item = NULL;
+    s->out = s->err = -1;
+
+    return ret;
+}
+/*---------------------------------------------------------------------------*/
+int parallel_main(int argc, char *argv[]) {
+    struct Parallel p = {0};
+    struct Slot *slots;
+    struct rusage usage = {0};
+    struct timespec start;
+    pid_t *pids;
+    int *statuses;
+    long jobs = 0;
+    int i, j, fd, running = 0, started = 0, failed = 0;
+    int stop = FALSE, broken = FALSE;
+    char *item, *end;
+
+    /* parallel [-j jobs] command [arg...] [::: item...] */
+    for (i = 1; i < argc && strncmp(argv[i], "-j", 2) == 0; i++) {
+        const char *n = argv[i][2] != '\0' ? argv[i] + 2 : argv[++i];
+
+        if (n == NULL || (jobs = strtol(n, &end, 10)) < 0 || *end != '\0' ||
+            end == n) {
+            parallel_error("-j takes a number of jobs", NULL);
+            return EXIT_FAILURE;
+        }
+    }
+    p.cmd = argv + i;
+    for (; i < argc && strcmp(argv[i], ":::") != 0; i++)
+        p.cmd_cnt++;
+    if (i < argc) {
+        p.items = argv + i + 1;
+        p.item_cnt = argc - i - 1;
+    }
+    if (p.cmd_cnt == 0) {
+        parallel_error("usage", "parallel [-j jobs] command [arg...] "
+                       "[::: item...]");
+        return EXIT_FAILURE;
+    }
+    if (jobs == 0)
+        jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    if (jobs < 1)
+        jobs = 1;
+
+    /* Look the command up once, unless it is made from the items */
+    if (strstr(p.cmd[0], "{}") == NULL) {
+        p.path = cmdhash_lookup(p.cmd[0]);
+        if (p.path == NULL) {
+            parallel_error(p.cmd[0], strerror(errno));
+            return EXIT_EXEC_FAIL;
+        }
+    }
+
+    if (p.items == NULL) {
+        fd = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 3);
+        p.in = fd >= 0 ? fdopen(fd, "r") : NULL;
+        if (p.in == NULL) {
+            if (fd >= 0)
+                close(fd);
+            parallel_error("stdin", strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+
+    slots = calloc(jobs, sizeof(struct Slot));
+    pids = calloc(jobs, sizeof(pid_t));
+    statuses = malloc(sizeof(int) * jobs);
+    if (slots == NULL || pids == NULL || statuses == NULL) {
+        error_print("Cannot allocate memory", FPRINTF);
+        broken = TRUE;
+        stop = TRUE;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (;;) {
+        /* Keep every slot busy */
+        for (i = 0; !stop && i < jobs && running < jobs; i++) {
+            if (pids[i] != 0)
+                continue;
+            if ((item = next_item(&p)) == NULL) {
+                stop = TRUE;
+                break;
+            }
+
+            slots[i].num = ++started;
+            pids[i] = start_job(&p, &slots[i], item);
+            statuses[i] = -1;
+            if (pids[i] < 0) {
+                if (slots[i].out >= 0)
+                    fdreg_close(slots[i].out);
+                if (slots[i].err >= 0)
+                    fdreg_close(slots[i].err);
+                free(item);
+                slots[i].item = NULL;
+                pids[i] = 0;
+                broken = TRUE;
+                stop = TRUE;
+                break;
+            }
+            running++;
+        }
+
+        if (running == 0 || evloop_wait_any(pids, jobs, statuses, &usage) < 0)
+            break;
+
+        for (i = 0; i < jobs; i++) {
+            if (pids[i] == 0 || statuses[i] == -1)
+                continue;
+            if (finish_job(&slots[i], statuses[i]) != 0)
+                failed++;
+            if (WIFSIGNALED(statuses[i]) && WTERMSIG(statuses[i]) == SIGINT)
+                stop = TRUE;
+            pids[i] = 0;
+            running--;
+        }
+    }
+
+    /* Nothing is left running unless waiting itself failed */
+    for (j = 0; slots != NULL && j < jobs; j++) {
+        if (slots[j].item != NULL) {
+            fdreg_close(slots[j].out);
+            fdreg_close(slots[j].err);
+            free(slots[j].item);
+        }
+    }
+
+    fprintf(stderr, "parallel: %d job%s, %d failed, ", started,
+            started == 1 ? "" : "s", failed);
+    rusage_print_line(stderr, rusage_since(&start), &usage);
+    fprintf(stderr, "\n");
+
+    if (p.in != NULL)
+        fclose(p.in);
+    free(p.line);
+    free(slots);
+    free(pids);
+    free(statuses);
+
+    if (failed > 0)
+        return failed > 100 ? 101 : failed;
+    return broken ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+/*---------------------------------------------------------------------------*/
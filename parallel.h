@@ -0,0 +1,33 @@
+/*---------------------------------------------------------------------------*/
+/* parallel.h                                                                */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+/* parallel [-j jobs] command [arg...] [::: item...]
+
+   Run command once per item, keeping up to jobs of them running at a
+   time (by default one per online CPU).  Each "{}" in the command and
+   its arguments is replaced with the item; if there is none, the item
+   is added as the last argument.  Without ":::" the items are the
+   lines of stdin, read as jobs are started, and the jobs get
+   /dev/null as stdin.
+
+   The jobs are children of whoever runs parallel, so in the shell
+   they are watched and reaped by the event loop like any command (see
+   evloop.h), and background groups that finish meanwhile are still
+   reported.  Each job's stdout and stderr are held in memory files and
+   written out together when it finishes, so the output of two jobs is
+   never interleaved.  After that output a line on stderr gives the
+   job's number, item, exit status and run time, and a last line gives
+   the number of jobs and failures with the elapsed time and the
+   resource usage of all the jobs.  A job killed by SIGINT stops any
+   more from being started.
+
+   The exit status is the number of jobs that failed, 101 if over 100,
+   or 1 if a job could not be started. */
+int parallel_main(int argc, char *argv[]);
+
+#endif /* _PARALLEL_H_ */
@@ -0,0 +1,78 @@
+/*---------------------------------------------------------------------------*/
+/* pipebuf.c                                                                 */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+
+#include "pipebuf.h"
+
+long pipebuf_size;
+
+/* pipe-max-size, read on first use; -1 if it cannot be read */
+static long max_size;
+
+/*---------------------------------------------------------------------------*/
+long pipebuf_parse(const char *s) {
+    char *end;
+    long n;
+    int shift = 0;
+
+    if (*s < '0' || *s > '9')
+        return -1;
+    errno = 0;
+    n = strtol(s, &end, 10);
+    if (errno == ERANGE)
+        return -1;
+
+    switch (*end) {
+    case 'G': case 'g': shift += 10; /* fall through */
+    case 'M': case 'm': shift += 10; /* fall through */
+    case 'K': case 'k': shift += 10; end++; break;
+    }
+
+    /* F_SETPIPE_SZ takes an int */
+    if (*end != '\0' || n > (INT_MAX >> shift))
+        return -1;
+    return n << shift;
+}
+/*---------------------------------------------------------------------------*/
+static long read_max_size(void) {
+    FILE *fp = fopen("/proc/sys/fs/pipe-max-size", "re");
+    long n;
+
+    if (fp == NULL)
+        return -1;
+    if (fscanf(fp, "%ld", &n) != 1)
+        n = -1;
+    fclose(fp);
+
+    return n;
+}
+/*---------------------------------------------------------------------------*/
+long pipebuf_apply(int fd, long size) {
+    int granted;
+
+    if (max_size == 0)
+        max_size = read_max_size();
+    if (max_size > 0 && size > max_size)
+        size = max_size;
+    if (size > INT_MAX)
+        size = INT_MAX;
+
+    /* The kernel rounds up to a power of two pages, so halving reaches
+       every size it could grant */
+    for (; size > PIPEBUF_DEFAULT; size /= 2) {
+        granted = fcntl(fd, F_SETPIPE_SZ, (int)size);
+        if (granted >= 0)
+            return granted;
+    }
+
+    granted = fcntl(fd, F_GETPIPE_SZ);
+    return granted >= 0 ? granted : PIPEBUF_DEFAULT;
+}
+/*---------------------------------------------------------------------------*/
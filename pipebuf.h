@@ -0,0 +1,33 @@
+/*---------------------------------------------------------------------------*/
+/* pipebuf.h                                                                 */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#ifndef _PIPEBUF_H_
+#define _PIPEBUF_H_
+
+/* The pipes between the stages of a pipeline can be given a larger
+   buffer than the kernel's 64 KB default with F_SETPIPE_SZ, so a
+   stage that writes in big chunks is not put to sleep after every
+   64 KB.  "set pipebuf=<size>" sets the size for every pipeline, and a
+   "pipebuf=<size>" word in front of a pipeline sets it for that one
+   only.  A size of 0 means the kernel default. */
+
+enum {PIPEBUF_DEFAULT = 65536};
+
+/* The size set with "set pipebuf", or 0 */
+extern long pipebuf_size;
+
+/* Return the number of bytes s names: digits with an optional K, M or
+   G suffix (powers of 1024).  Return -1 if s is not a size or names
+   more than INT_MAX bytes. */
+long pipebuf_parse(const char *s);
+
+/* Give the pipe fd a buffer of size bytes.  A size above
+   /proc/sys/fs/pipe-max-size, or one the kernel refuses for lack of
+   pipe memory, is reduced step by step; if nothing above the default
+   is granted the pipe is left as it is.  Return the size the pipe
+   ends up with. */
+long pipebuf_apply(int fd, long size);
+
+#endif /* _PIPEBUF_H_ */
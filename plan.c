@@ -0,0 +1,118 @@
+/*---------------------------------------------------------------------------*/
+/* plan.c                                                                    */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#include <stddef.h>
+#include <string.h>
+
+#include "plan.h"
+#include "util.h"
+#include "snush.h"
+#include "pipebuf.h"
+#include "builtin.h"
+#include "filter.h"
+
+/*---------------------------------------------------------------------------*/
+static void stage_init(struct CommandInfo *cmd, char **args) {
+    cmd->redirect_out = NULL;
+    cmd->redirect_in = NULL;
+    cmd->cnt = 0;
+    cmd->args = args;
+    cmd->path = NULL;
+    cmd->builtin = NULL;
+    cmd->filter = NULL;
+    cmd->fanout = FALSE;
+}
+/*---------------------------------------------------------------------------*/
+static void stage_finish(struct CommandInfo *cmd) {
+    const struct Builtin *b = builtin_find(cmd->args[0]);
+
+    cmd->args[cmd->cnt] = NULL;
+    if (b != NULL)
+        cmd->builtin = b->fn;
+    else
+        cmd->filter = filter_find(cmd->cnt, cmd->args);
+}
+/*---------------------------------------------------------------------------*/
+struct Plan *plan_compile(TokenVec_T oTokens, Arena_T oArena) {
+    int i, len = tokvec_get_length(oTokens);
+    enum TokenType pending = TOKEN_WORD;
+    struct CommandInfo *cmd;
+    struct Plan *plan;
+    struct Token *t;
+    char **args, *word;
+
+    /* A checked line starts with a word and has a word after each '|'
+       or "|+", so it has at most len / 2 + 1 stages.  Their argument
+       vectors share one block: every word plus one NULL per stage. */
+    plan = arena_alloc(oArena, sizeof(struct Plan));
+    if (plan == NULL)
+        return NULL;
+    plan->stages = arena_alloc(oArena,
+                               sizeof(struct CommandInfo) * (len / 2 + 1));
+    args = arena_alloc(oArena, sizeof(char *) * (len + len / 2 + 1));
+    if (plan->stages == NULL || args == NULL)
+        return NULL;
+
+    plan->stage_cnt = 1;
+    plan->background = FALSE;
+    plan->timed = FALSE;
+    plan->pipebuf = -1;
+    cmd = &plan->stages[0];
+    stage_init(cmd, args);
+
+    /* "time" and "pipebuf=" are keywords only in front of a command */
+    for (i = 0; i + 1 < len &&
+             tokvec_get(oTokens, i + 1)->token_type == TOKEN_WORD; i++) {
+        word = tokvec_get_value(oTokens, i);
+        if (!plan->timed && strcmp(word, "time") == 0)
+            plan->timed = TRUE;
+        else if (plan->pipebuf < 0 && strncmp(word, "pipebuf=", 8) == 0 &&
+                 pipebuf_parse(word + 8) >= 0)
+            plan->pipebuf = pipebuf_parse(word + 8);
+        else
+            break;
+    }
+
+    for (; i < len; i++) {
+        t = tokvec_get(oTokens, i);
+
+        switch (t->token_type) {
+        case TOKEN_WORD:
+            if (pending == TOKEN_REDIN)
+                cmd->redirect_in = tokvec_get_value(oTokens, i);
+            else if (pending == TOKEN_REDOUT)
+                cmd->redirect_out = tokvec_get_value(oTokens, i);
+            else
+                cmd->args[cmd->cnt++] = tokvec_get_value(oTokens, i);
+            pending = TOKEN_WORD;
+            break;
+
+        case TOKEN_REDIN:
+        case TOKEN_REDOUT:
+            pending = t->token_type;
+            break;
+
+        case TOKEN_PIPE:
+        case TOKEN_FANOUT:
+            stage_finish(cmd);
+            args = cmd->args + cmd->cnt + 1;
+            cmd = &plan->stages[plan->stage_cnt++];
+            stage_init(cmd, args);
+            cmd->fanout = (t->token_type == TOKEN_FANOUT);
+            break;
+
+        case TOKEN_BG:
+            plan->background = TRUE;
+            break;
+        }
+    }
+    stage_finish(cmd);
+
+    /* Only jobs the terminal may switch between need their own group */
+    plan->own_group = interactive || plan->background;
+
+    return plan;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,53 @@
+/*---------------------------------------------------------------------------*/
+/* plan.h                                                                    */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#ifndef _PLAN_H_
+#define _PLAN_H_
+
+#include "token.h"
+#include "arena.h"
+
+/* A Plan is what a command line compiles to before anything is
+   started: the stages of its pipeline with their argument vectors and
+   redirections, and how the pipeline is to be run.  A pipeline with
+   "|+" in it is a tree rather than a chain: the stages before the
+   first "|+" are its head, and each "|+" starts a branch that reads
+   everything the head writes.  The stages are still kept in line
+   order, with fanout set on the first stage of each branch.  It is
+   built in one pass over the tokens, lives in the line arena, and is
+   not modified by running it; each stage is copied before its path is
+   resolved. */
+
+struct CommandInfo
+{
+    char *redirect_out; // File for output redirection
+    char *redirect_in;  // File for input redirection
+    int cnt;            // Number of arguments
+    char **args;        // Argument vector carved from the line arena
+    const char *path;   // Executable resolved through the PATH cache
+    int (*builtin)(int argc, char *argv[]); // In-shell version, or NULL
+    int (*filter)(int argc, char *argv[], int in, int out); // Native version
+    int fanout;         // Starts a branch after "|+"
+};
+
+struct Plan
+{
+    struct CommandInfo *stages; // Commands connected by pipes, in order
+    int stage_cnt;              // At least 1
+    int background;             // The line ended with '&'
+    int timed;                  // The line started with "time"
+    int own_group;              // Run the stages in a new process group
+    long pipebuf;               // Pipe buffer size, or -1 for pipebuf_size
+};
+
+/* Compile oTokens, which must have passed syntax_check(), into a Plan
+   allocated from oArena.  A leading "time" followed by a command sets
+   timed rather than becoming the command, and so does a leading
+   "pipebuf=<size>" set pipebuf.  A stage's path is left NULL, and
+   its builtin or filter is set if the shell implements its command
+   itself.  Return NULL if insufficient memory is available. */
+struct Plan *plan_compile(TokenVec_T oTokens, Arena_T oArena);
+
+#endif /* _PLAN_H_ */
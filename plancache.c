@@ -0,0 +1,206 @@
+/*---------------------------------------------------------------------------*/
+/* plancache.c                                                               */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "plancache.h"
+
+enum {BUCKET_CNT = PLANCACHE_SIZE * 2};
+
+/* An entry, its plan, argument vectors and strings are one malloc()ed
+   block, in that order. */
+struct PlanEntry {
+    char *line;
+    unsigned int hash;
+    struct Plan plan;
+
+    /* Hash chain */
+    struct PlanEntry *next;
+
+    /* Use order, most recently used first */
+    struct PlanEntry *newer;
+    struct PlanEntry *older;
+};
+
+static struct PlanEntry *buckets[BUCKET_CNT];
+static struct PlanEntry *newest, *oldest;
+static int entry_cnt;
+static unsigned long hits, misses;
+
+/*---------------------------------------------------------------------------*/
+static unsigned int hash_line(const char *line) {
+    unsigned int h = 2166136261u;
+
+    /* FNV-1a */
+    while (*line != '\0') {
+        h ^= (unsigned char)*line++;
+        h *= 16777619u;
+    }
+
+    return h;
+}
+/*---------------------------------------------------------------------------*/
+static struct PlanEntry *find(const char *line, unsigned int h) {
+    struct PlanEntry *e;
+
+    for (e = buckets[h % BUCKET_CNT]; e != NULL; e = e->next)
+        if (e->hash == h && strcmp(e->line, line) == 0)
+            return e;
+
+    return NULL;
+}
+/*---------------------------------------------------------------------------*/
+static void unlink_use(struct PlanEntry *e) {
+    if (e->newer != NULL)
+        e->newer->older = e->older;
+    else
+        newest = e->older;
+
+    if (e->older != NULL)
+        e->older->newer = e->newer;
+    else
+        oldest = e->newer;
+}
+/*---------------------------------------------------------------------------*/
+static void link_newest(struct PlanEntry *e) {
+    e->newer = NULL;
+    e->older = newest;
+    if (newest != NULL)
+        newest->newer = e;
+    else
+        oldest = e;
+    newest = e;
+}
+/*---------------------------------------------------------------------------*/
+static void evict(struct PlanEntry *e) {
+    struct PlanEntry **pp = &buckets[e->hash % BUCKET_CNT];
+
+    while (*pp != e)
+        pp = &(*pp)->next;
+    *pp = e->next;
+
+    unlink_use(e);
+    free(e);
+    entry_cnt--;
+}
+/*---------------------------------------------------------------------------*/
+static char *copy_str(char **pos, const char *s) {
+    size_t len = strlen(s) + 1;
+    char *copy = *pos;
+
+    memcpy(copy, s, len);
+    *pos += len;
+
+    return copy;
+}
+/*---------------------------------------------------------------------------*/
+/* Return a copy of plan and line in one block, or NULL if insufficient
+   memory is available. */
+static struct PlanEntry *copy_plan(const char *line, const struct Plan *plan) {
+    const struct CommandInfo *src;
+    struct CommandInfo *dst;
+    struct PlanEntry *e;
+    size_t slots = 0, chars = strlen(line) + 1;
+    char **args, *pos;
+    int i, j;
+
+    for (i = 0; i < plan->stage_cnt; i++) {
+        src = &plan->stages[i];
+        slots += src->cnt + 1;
+        for (j = 0; j < src->cnt; j++)
+            chars += strlen(src->args[j]) + 1;
+        if (src->redirect_in != NULL)
+            chars += strlen(src->redirect_in) + 1;
+        if (src->redirect_out != NULL)
+            chars += strlen(src->redirect_out) + 1;
+    }
+
+    e = malloc(sizeof(struct PlanEntry) +
+               sizeof(struct CommandInfo) * plan->stage_cnt +
+               sizeof(char *) * slots + chars);
+    if (e == NULL)
+        return NULL;
+
+    e->plan = *plan;
+    e->plan.stages = (struct CommandInfo *)(e + 1);
+    args = (char **)(e->plan.stages + plan->stage_cnt);
+    pos = (char *)(args + slots);
+    e->line = copy_str(&pos, line);
+
+    for (i = 0; i < plan->stage_cnt; i++) {
+        src = &plan->stages[i];
+        dst = &e->plan.stages[i];
+
+        *dst = *src;
+        dst->path = NULL;
+        dst->args = args;
+        for (j = 0; j < src->cnt; j++)
+            dst->args[j] = copy_str(&pos, src->args[j]);
+        dst->args[j] = NULL;
+        args += src->cnt + 1;
+
+        if (src->redirect_in != NULL)
+            dst->redirect_in = copy_str(&pos, src->redirect_in);
+        if (src->redirect_out != NULL)
+            dst->redirect_out = copy_str(&pos, src->redirect_out);
+    }
+
+    return e;
+}
+/*---------------------------------------------------------------------------*/
+const struct Plan *plancache_lookup(const char *line) {
+    struct PlanEntry *e = find(line, hash_line(line));
+
+    if (e == NULL) {
+        misses++;
+        return NULL;
+    }
+
+    hits++;
+    unlink_use(e);
+    link_newest(e);
+
+    return &e->plan;
+}
+/*---------------------------------------------------------------------------*/
+int plancache_insert(const char *line, const struct Plan *plan) {
+    unsigned int h;
+    struct PlanEntry *e;
+
+    if (strlen(line) > PLANCACHE_MAX_LINE)
+        return -1;
+
+    h = hash_line(line);
+    if (find(line, h) != NULL)
+        return 0;
+
+    e = copy_plan(line, plan);
+    if (e == NULL)
+        return -1;
+
+    if (entry_cnt == PLANCACHE_SIZE)
+        evict(oldest);
+
+    e->hash = h;
+    e->next = buckets[h % BUCKET_CNT];
+    buckets[h % BUCKET_CNT] = e;
+    link_newest(e);
+    entry_cnt++;
+
+    return 0;
+}
+/*---------------------------------------------------------------------------*/
+void plancache_clear(void) {
+    while (oldest != NULL)
+        evict(oldest);
+}
+/*---------------------------------------------------------------------------*/
+void plancache_print(void) {
+    printf("plan cache: %d/%d lines, %lu hits, %lu misses\n",
+           entry_cnt, PLANCACHE_SIZE, hits, misses);
+}
+/*---------------------------------------------------------------------------*/
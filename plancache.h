@@ -0,0 +1,44 @@
+/*---------------------------------------------------------------------------*/
+/* plancache.h                                                               */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#ifndef _PLANCACHE_H_
+#define _PLANCACHE_H_
+
+#include "plan.h"
+
+/* The plan cache remembers the compiled Plan of recently run command
+   lines, so a line that is run again is not lexed or checked again.
+   Lines are looked up by a hash of their exact text; at most
+   PLANCACHE_SIZE of them are kept, and the least recently used one is
+   dropped to make room.  Lines longer than PLANCACHE_MAX_LINE bytes
+   are not cached.
+
+   A Plan holds only the words of the line, never a resolved path, the
+   working directory or the value of a variable: commands are looked up
+   through the PATH cache when a stage is started, and relative names
+   are resolved by the kernel at that point.  A cached plan therefore
+   stays valid across cd and environment changes. */
+
+enum {PLANCACHE_SIZE = 128};
+enum {PLANCACHE_MAX_LINE = 4096};
+
+/* Return the plan cached for line, or NULL if there is none.  The plan
+   is owned by the cache and stays valid until the next
+   plancache_insert() or plancache_clear(). */
+const struct Plan *plancache_lookup(const char *line);
+
+/* Remember a copy of plan as the compilation of line.  Return 0 on
+   success, or -1 if line is too long or insufficient memory is
+   available. */
+int plancache_insert(const char *line, const struct Plan *plan);
+
+/* Forget every cached plan.  The hit and miss counters are kept. */
+void plancache_clear(void);
+
+/* Write the number of cached lines and the hit and miss counts to
+   stdout. */
+void plancache_print(void);
+
+#endif /* _PLANCACHE_H_ */
@@ -0,0 +1,172 @@
+/*---------------------------------------------------------------------------*/
+/* reader.c                                                                  */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "reader.h"
+
+enum {INITIAL_SIZE = 4096};
+enum {BULK_CHUNK = 65536};
+
+struct LineReader {
+    int fd;
+
+    /* Bytes to ask read(2) for at a time */
+    size_t chunk;
+
+    /* Longest line accepted (ARG_MAX) */
+    size_t max_line;
+
+    /* buf[start, end) holds data not yet returned; buf[start, scan)
+       is known to contain no newline. */
+    char *buf;
+    size_t size;
+    size_t start;
+    size_t scan;
+    size_t end;
+
+    /* Skipping the rest of an overlong line */
+    int discarding;
+};
+
+/*---------------------------------------------------------------------------*/
+LineReader_T reader_new(int fd) {
+    LineReader_T oReader;
+    struct stat st;
+    long arg_max;
+
+    oReader = calloc(1, sizeof(struct LineReader));
+    if (oReader == NULL)
+        return NULL;
+
+    oReader->buf = malloc(INITIAL_SIZE);
+    if (oReader->buf == NULL) {
+        free(oReader);
+        return NULL;
+    }
+    oReader->size = INITIAL_SIZE;
+    oReader->fd = fd;
+
+    /* A terminal hands out one line per read anyway */
+    if (fstat(fd, &st) == 0 &&
+        (S_ISREG(st.st_mode) || S_ISFIFO(st.st_mode)))
+        oReader->chunk = BULK_CHUNK;
+    else
+        oReader->chunk = INITIAL_SIZE;
+
+    arg_max = sysconf(_SC_ARG_MAX);
+    oReader->max_line = arg_max > 0 ? (size_t)arg_max : 131072;
+
+    return oReader;
+}
+/*---------------------------------------------------------------------------*/
+void reader_free(LineReader_T oReader) {
+    if (oReader == NULL)
+        return;
+
+    free(oReader->buf);
+    free(oReader);
+}
+/*---------------------------------------------------------------------------*/
+/* Make room for at least one more chunk after end.  Return 0 on
+   success or -1 if insufficient memory is available. */
+static int make_room(LineReader_T oReader) {
+    size_t pending = oReader->end - oReader->start;
+    size_t want, new_size;
+    char *buf;
+
+    /* Slide unreturned data to the front first */
+    if (oReader->start > 0) {
+        memmove(oReader->buf, oReader->buf + oReader->start, pending);
+        oReader->scan -= oReader->start;
+        oReader->end = pending;
+        oReader->start = 0;
+    }
+
+    want = pending + oReader->chunk + 1;
+    if (want <= oReader->size)
+        return 0;
+
+    new_size = oReader->size * 2;
+    if (new_size < want)
+        new_size = want;
+
+    buf = realloc(oReader->buf, new_size);
+    if (buf == NULL)
+        return -1;
+    oReader->buf = buf;
+    oReader->size = new_size;
+
+    return 0;
+}
+/*---------------------------------------------------------------------------*/
+int reader_has_line(LineReader_T oReader) {
+    return memchr(oReader->buf + oReader->scan, '\n',
+                  oReader->end - oReader->scan) != NULL;
+}
+/*---------------------------------------------------------------------------*/
+enum ReadResult reader_getline(LineReader_T oReader, char **line,
+                               size_t *len) {
+    char *nl;
+    ssize_t n;
+
+    for (;;) {
+        nl = memchr(oReader->buf + oReader->scan, '\n',
+                    oReader->end - oReader->scan);
+
+        if (nl != NULL) {
+            *nl = '\0';
+            *line = oReader->buf + oReader->start;
+            *len = nl - *line;
+            oReader->start = oReader->scan = nl - oReader->buf + 1;
+
+            if (oReader->discarding) {
+                oReader->discarding = 0;
+                return READ_TOOLONG;
+            }
+            return READ_LINE;
+        }
+        oReader->scan = oReader->end;
+
+        /* Drop an overlong line as it streams in */
+        if (oReader->discarding ||
+            oReader->end - oReader->start > oReader->max_line) {
+            oReader->discarding = 1;
+            oReader->start = oReader->scan = oReader->end = 0;
+        }
+
+        if (make_room(oReader) < 0) {
+            errno = ENOMEM;
+            return READ_ERROR;
+        }
+
+        n = read(oReader->fd, oReader->buf + oReader->end, oReader->chunk);
+        if (n < 0)
+            return errno == EINTR ? READ_EINTR : READ_ERROR;
+
+        if (n == 0) {
+            if (oReader->discarding) {
+                oReader->discarding = 0;
+                return READ_TOOLONG;
+            }
+            if (oReader->end == oReader->start)
+                return READ_EOF;
+
+            /* Last line without a newline; make_room left a spare byte */
+            oReader->buf[oReader->end] = '\0';
+            *line = oReader->buf + oReader->start;
+            *len = oReader->end - oReader->start;
+            oReader->start = oReader->scan = oReader->end;
+            return READ_LINE;
+        }
+
+        oReader->end += n;
+    }
+}
+/*---------------------------------------------------------------------------*/
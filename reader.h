@@ -0,0 +1,48 @@
+/*---------------------------------------------------------------------------*/
+/* reader.h                                                                  */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#ifndef _READER_H_
+#define _READER_H_
+
+#include <stddef.h>
+
+/* A LineReader splits the bytes of a file descriptor into lines.  It
+   reads with read(2) into a buffer that grows as needed, so a line may
+   be as long as ARG_MAX.  When the descriptor is a file or a pipe it
+   reads in large chunks, so a script of many short lines costs few
+   system calls. */
+typedef struct LineReader *LineReader_T;
+
+enum ReadResult {
+    READ_LINE,      /* A line was returned */
+    READ_EOF,       /* No more input */
+    READ_EINTR,     /* Interrupted by a signal; call again */
+    READ_TOOLONG,   /* A line longer than ARG_MAX was discarded */
+    READ_ERROR      /* read(2) failed; errno is set */
+};
+
+
+/* Return a new LineReader reading from fd, or NULL if insufficient
+   memory is available.  fd is not closed by reader_free(). */
+LineReader_T reader_new(int fd);
+
+
+/* Free oReader. */
+void reader_free(LineReader_T oReader);
+
+
+/* Read the next line from oReader.  On READ_LINE, *line points to the
+   line without its newline, NUL-terminated, and *len is its length.
+   The line lives in oReader's buffer and may be modified by the
+   caller; it stays valid until the next call.  A last line without a
+   trailing newline is returned as a line. */
+enum ReadResult reader_getline(LineReader_T oReader, char **line,
+                               size_t *len);
+
+/* Return 1 if oReader holds a whole line that reader_getline() can
+   return without reading, 0 if not. */
+int reader_has_line(LineReader_T oReader);
+
+#endif /* _READER_H_ */
@@ -0,0 +1,102 @@
+/*---------------------------------------------------------------------------*/
+/* reap.c                                                                    */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+
+#include "reap.h"
+
+static struct ReapEvent ring[REAP_RING_SIZE];
+
+/* Free-running indexes; head - tail events are queued */
+static unsigned int ring_head;
+static unsigned int ring_tail;
+
+/* reap_children() stopped because the ring was full */
+static int ring_full;
+
+/*---------------------------------------------------------------------------*/
+void reap_children(void) {
+    int saved_errno = errno;
+    struct ReapEvent *ev;
+    pid_t pid;
+
+    for (;;) {
+        /* Leave the rest as zombies until there is room */
+        if (ring_head - ring_tail == REAP_RING_SIZE) {
+            ring_full = 1;
+            break;
+        }
+
+        ev = &ring[ring_head % REAP_RING_SIZE];
+        pid = wait4(-1, &ev->status, WNOHANG, &ev->usage);
+        if (pid <= 0)
+            break;
+        ev->pid = pid;
+        ring_head++;
+    }
+
+    errno = saved_errno;
+}
+/*---------------------------------------------------------------------------*/
+/* The wait status waitpid() would have reported for info */
+static int wait_status(const siginfo_t *info) {
+    switch (info->si_code) {
+    case CLD_EXITED:
+        return (info->si_status & 0xff) << 8;
+    case CLD_DUMPED:
+        return info->si_status | 0x80;
+    default:
+        return info->si_status;
+    }
+}
+/*---------------------------------------------------------------------------*/
+int reap_pidfd(int pidfd) {
+    struct ReapEvent *ev;
+    siginfo_t info;
+
+    /* A pidfd cannot come to mean another process, so this cannot
+       reap a recycled pid the way wait4(pid) could */
+    if (ring_head - ring_tail == REAP_RING_SIZE)
+        return 0;
+
+    ev = &ring[ring_head % REAP_RING_SIZE];
+    info.si_pid = 0;
+
+    /* glibc's waitid() does not return the rusage */
+    if (syscall(SYS_waitid, P_PIDFD, pidfd, &info, WEXITED | WNOHANG,
+                &ev->usage) < 0)
+        return errno == ECHILD ? -1 : 0;
+    if (info.si_pid == 0)
+        return 0;
+
+    ev->pid = info.si_pid;
+    ev->status = wait_status(&info);
+    ring_head++;
+
+    return 1;
+}
+/*---------------------------------------------------------------------------*/
+int reap_next(struct ReapEvent *ev) {
+    if (ring_head == ring_tail) {
+        if (!ring_full)
+            return 0;
+
+        /* Collect what reap_children() had to leave behind */
+        ring_full = 0;
+        reap_children();
+        if (ring_head == ring_tail)
+            return 0;
+    }
+
+    *ev = ring[ring_tail % REAP_RING_SIZE];
+    ring_tail++;
+
+    return 1;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,41 @@
+/*---------------------------------------------------------------------------*/
+/* reap.h                                                                    */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#ifndef _REAP_H_
+#define _REAP_H_
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+/* Terminated children are reaped as the event loop learns about them
+   (see evloop.h) and queued as ReapEvents in a preallocated ring, from
+   which they are handed to whoever waits for them.  Reaping never
+   allocates memory. */
+
+enum {REAP_RING_SIZE = 1024};
+
+struct ReapEvent {
+    pid_t pid;
+    int status;
+    struct rusage usage;
+};
+
+/* Reap every terminated child with wait4(WNOHANG) and queue a
+   ReapEvent for each.  If the ring is full the remaining children are
+   left for reap_next() to collect.  errno is preserved. */
+void reap_children(void);
+
+/* Reap the child pidfd refers to, if it has terminated, and queue a
+   ReapEvent for it.  Return 1 if it was reaped, -1 if it had already
+   been reaped (e.g. by reap_children()), or 0 if it is still
+   running. */
+int reap_pidfd(int pidfd);
+
+/* Store the oldest queued ReapEvent in *ev.  Return 1 if there was
+   one, 0 if the ring is empty. */
+int reap_next(struct ReapEvent *ev);
+
+#endif /* _REAP_H_ */
@@ -0,0 +1,63 @@
+/*---------------------------------------------------------------------------*/
+/* rusage.c                                                                  */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#include "rusage.h"
+
+/*---------------------------------------------------------------------------*/
+void rusage_add(struct rusage *sum, const struct rusage *usage) {
+    timeradd(&sum->ru_utime, &usage->ru_utime, &sum->ru_utime);
+    timeradd(&sum->ru_stime, &usage->ru_stime, &sum->ru_stime);
+
+    if (usage->ru_maxrss > sum->ru_maxrss)
+        sum->ru_maxrss = usage->ru_maxrss;
+
+    sum->ru_minflt += usage->ru_minflt;
+    sum->ru_majflt += usage->ru_majflt;
+    sum->ru_nvcsw += usage->ru_nvcsw;
+    sum->ru_nivcsw += usage->ru_nivcsw;
+}
+/*---------------------------------------------------------------------------*/
+double rusage_since(const struct timespec *start) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) +
+           (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+/*---------------------------------------------------------------------------*/
+static double seconds(const struct timeval *tv) {
+    return tv->tv_sec + tv->tv_usec / 1e6;
+}
+/*---------------------------------------------------------------------------*/
+/* Write secs the way bash's time keyword does, e.g. "0m1.250s" */
+static void print_secs(FILE *fp, double secs) {
+    int min = (int)(secs / 60);
+
+    fprintf(fp, "%dm%.3fs", min, secs - min * 60);
+}
+/*---------------------------------------------------------------------------*/
+void rusage_print(FILE *fp, double real, const struct rusage *usage) {
+    fprintf(fp, "\nreal\t");
+    print_secs(fp, real);
+    fprintf(fp, "\nuser\t");
+    print_secs(fp, seconds(&usage->ru_utime));
+    fprintf(fp, "\nsys\t");
+    print_secs(fp, seconds(&usage->ru_stime));
+    fprintf(fp, "\nmaxrss\t%ld KB\n", usage->ru_maxrss);
+    fprintf(fp, "faults\t%ld minor, %ld major\n",
+            usage->ru_minflt, usage->ru_majflt);
+    fprintf(fp, "ctxsw\t%ld voluntary, %ld involuntary\n",
+            usage->ru_nvcsw, usage->ru_nivcsw);
+}
+/*---------------------------------------------------------------------------*/
+void rusage_print_line(FILE *fp, double real, const struct rusage *usage) {
+    fprintf(fp, "real %.3fs user %.3fs sys %.3fs maxrss %ld KB "
+            "faults %ld/%ld ctxsw %ld/%ld",
+            real, seconds(&usage->ru_utime), seconds(&usage->ru_stime),
+            usage->ru_maxrss, usage->ru_minflt, usage->ru_majflt,
+            usage->ru_nvcsw, usage->ru_nivcsw);
+}
+/*---------------------------------------------------------------------------*/
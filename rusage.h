@@ -0,0 +1,33 @@
+/*---------------------------------------------------------------------------*/
+/* rusage.h                                                                  */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#ifndef _RUSAGE_H_
+#define _RUSAGE_H_
+
+#include <stdio.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+/* Resource usage of commands comes from the rusage wait4() and
+   waitid() return for each child (see reap.h).  The usage of a
+   pipeline or a background job is the sum over its processes. */
+
+/* Add *usage to *sum.  Times and counters add up; ru_maxrss becomes
+   the larger of the two, since the processes did not share memory. */
+void rusage_add(struct rusage *sum, const struct rusage *usage);
+
+/* Return the seconds elapsed on CLOCK_MONOTONIC since *start. */
+double rusage_since(const struct timespec *start);
+
+/* Write the report of the time keyword to fp: real, user and system
+   time, maximum resident set size, page faults and context switches,
+   one per line. */
+void rusage_print(FILE *fp, double real, const struct rusage *usage);
+
+/* Write the same numbers to fp on one line, without a newline. */
+void rusage_print_line(FILE *fp, double real, const struct rusage *usage);
+
+#endif /* _RUSAGE_H_ */
@@ -5,10 +5,21 @@
 
 #include "util.h"
 #include "token.h"
-#include "dynarray.h"
+#include "arena.h"
+#include "reader.h"
 #include "execute.h"
 #include "lexsyn.h"
 #include "snush.h"
+#include "spawn.h"
+#include "jobs.h"
+#include "evloop.h"
+#include "fdreg.h"
+#include "plan.h"
+#include "plancache.h"
+#include "status.h"
+#include "stats.h"
+#include "trace.h"
+#include "optimize.h"
 
 /*
         //
@@ -22,177 +33,129 @@
         //
 */
 
-struct BgProcessList bg_list;
-int bg_messages_pending = 0;
-int bg_process_completed = 0;
-int total_bg_cnt;
 int prompt_needed = 1;
+int interactive = 1;
+int last_status = EXIT_SUCCESS;
+
+/* The line being run, its argument vectors and command descriptions
+   live in line_arena; its tokens go to oTokens, which is reused for
+   every line. */
+static Arena_T line_arena;
+static TokenVec_T oTokens;
+
+/* A forked child that fails to exec also runs cleanup(), and must not
+   write the shell's reports */
+static pid_t shell_pid;
 
 /*---------------------------------------------------------------------------*/
 void cleanup()
 {
     // Free any allocated memory for background processes
-    for (int i = 0; i < bg_list.count; i++)
+    jobs_clear();
+    plancache_clear();
+    status_free();
+
+    if (getpid() == shell_pid)
     {
-        if (bg_list.processes[i].cmd != NULL)
-        {
-            free(bg_list.processes[i].cmd);
-        }
+        if (getenv("SNUSH_STATS") != NULL)
+            stats_print(stderr);
+        trace_close();
     }
-    // Reset the background process count
-    bg_list.count = 0;
 }
 /*---------------------------------------------------------------------------*/
-void check_bg_status(void)
+static void run_plan(const struct Plan *plan)
 {
-    for (int i = 0; i < bg_list.completed_count; i++)
-    {
-        if (!bg_list.completed[i].printed)
-        {
-            prompt_needed = 0;
-            printf("[%d] Done background process group\n", bg_list.completed[i].pgid);
-            bg_list.completed[i].printed = 1;
-        }
-    }
+    int ret_pgid; // background pid
+
+    if (plan->stage_cnt > 1)
+        ret_pgid = iter_pipe_fork_exec(plan);
+    else
+        ret_pgid = fork_exec(plan);
 
-    // Clean up the completed array
-    int new_count = 0;
-    for (int i = 0; i < bg_list.completed_count; i++)
+    if (ret_pgid > 0)
     {
-        if (!bg_list.completed[i].printed)
-        {
-            bg_list.completed[new_count] = bg_list.completed[i];
-            new_count++;
-        }
+        if (plan->background)
+            printf("[%d] Background process running\n", ret_pgid);
     }
-    bg_list.completed_count = new_count;
-}
-/*---------------------------------------------------------------------------*/
-/* Whenever a child process terminates, this handler handles all zombies. */
-static void sigzombie_handler(int signo)
-{
-    pid_t pid;
-    int status;
-
-    if (signo == SIGCHLD)
+    else if (ret_pgid < 0)
     {
-        while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
-        {
-            pid_t current_pgid = -1;
-
-            // Find the process's pgid
-            for (int i = 0; i < bg_list.count; i++)
-            {
-                if (bg_list.processes[i].pid == pid)
-                {
-                    current_pgid = bg_list.processes[i].pgid;
-
-                    // Remove this process from the list
-                    free(bg_list.processes[i].cmd);
-                    for (int j = i; j < bg_list.count - 1; j++)
-                    {
-                        bg_list.processes[j] = bg_list.processes[j + 1];
-                    }
-                    bg_list.count--;
-                    if (total_bg_cnt > 0)
-                        total_bg_cnt--;
-                    break;
-                }
-            }
-
-            if (current_pgid != -1)
-            {
-                int remaining = 0;
-                for (int i = 0; i < bg_list.count; i++)
-                {
-                    if (bg_list.processes[i].pgid == current_pgid)
-                    {
-                        remaining++;
-                    }
-                }
-
-                if (remaining == 0 && bg_list.completed_count < MAX_BG_PRO)
-                {
-                    bg_list.completed[bg_list.completed_count].pgid = current_pgid;
-                    bg_list.completed[bg_list.completed_count].printed = 0;
-                    bg_list.completed_count++;
-                    prompt_needed = 0; // Don't print prompt after completion
-                }
-            }
-        }
+        printf("Invalid return value "
+               "of external command execution\n");
+        status_set(EXIT_FAILURE);
     }
 }
 /*---------------------------------------------------------------------------*/
 static void shell_helper(const char *in_line)
 {
-    DynArray_T oTokens;
 
     enum LexResult lexcheck;
     enum SyntaxResult syncheck;
     enum BuiltinType btype;
-    int pcount;
-    int ret_pgid; // background pid
-    int is_background;
-
-    oTokens = dynarray_new(0);
-    if (oTokens == NULL)
+    const struct Plan *cached;
+    struct Plan *plan;
+    const char *line;
+    long long start;
+
+    /* A line that ran before needs no lexing or checking */
+    cached = plancache_lookup(in_line);
+    if (cached != NULL)
     {
-        error_print("Cannot allocate memory", FPRINTF);
-        exit(EXIT_FAILURE);
+        run_plan(cached);
+        return;
     }
 
-    lexcheck = lex_line(in_line, oTokens);
+    /* $? and $PIPESTATUS change from run to run, so a line that uses
+       them is expanded every time and never cached */
+    line = status_expand(in_line, line_arena);
+    if (line == NULL)
+        lexcheck = LEX_NOMEM;
+    else
+    {
+        start = stats_now();
+        lexcheck = lex_line(line, oTokens, line_arena);
+        stats_record(STAT_LEX, start);
+        trace_span("lex", start, 0, 0, NULL);
+    }
     switch (lexcheck)
     {
     case LEX_SUCCESS:
-        if (dynarray_get_length(oTokens) == 0)
-            return;
+        if (tokvec_get_length(oTokens) == 0)
+            break;
 
         /* dump lex result when DEBUG is set */
         dump_lex(oTokens);
 
+        start = stats_now();
         syncheck = syntax_check(oTokens);
+        stats_record(STAT_PARSE, start);
+        trace_span("parse", start, 0, 0, NULL);
         if (syncheck == SYN_SUCCESS)
         {
-            btype = check_builtin(dynarray_get(oTokens, 0));
+            btype = check_builtin(tokvec_get_value(oTokens, 0));
+            /* Everything the children need is worked out before forking */
             if (btype == NORMAL)
             {
-                is_background = check_bg(oTokens);
-
-                pcount = count_pipe(oTokens);
-
-                if (is_background)
-                {
-                    if (total_bg_cnt + pcount + 1 > MAX_BG_PRO)
-                    {
-                        printf("Error: Total background processes "
-                               "exceed the limit (%d).\n",
-                               MAX_BG_PRO);
-                        return;
-                    }
-                }
-
-                if (pcount > 0)
-                {
-                    ret_pgid = iter_pipe_fork_exec(pcount, oTokens,
-                                                   is_background);
-                }
-                else
-                {
-                    ret_pgid = fork_exec(oTokens, is_background);
-                }
-
-                if (ret_pgid > 0)
-                {
-                    if (is_background == 1)
-                        printf("[%d] Background process running\n",
-                               ret_pgid);
-                }
-                else
-                {
-                    printf("Invalid return value "
-                           "of external command execution\n");
-                }
+                start = stats_now();
+                /* Failing to optimize only costs the stages it would
+                   have removed */
+                if (optimize_lines)
+                    optimize_tokens(oTokens, line_arena);
+                plan = plan_compile(oTokens, line_arena);
+                stats_record(STAT_PLAN, start);
+                trace_span("plan", start, 0, 0, NULL);
+            }
+
+            if (btype == NORMAL && plan == NULL)
+            {
+                error_print("Cannot allocate memory", FPRINTF);
+                status_set(EXIT_FAILURE);
+            }
+            else if (btype == NORMAL)
+            {
+                // Failing to cache only costs the next run a compile
+                if (line == in_line)
+                    plancache_insert(in_line, plan);
+                run_plan(plan);
             }
             else
             {
@@ -202,32 +165,35 @@ static void shell_helper(const char *in_line)
         }
 
         /* syntax error cases */
-        else if (syncheck == SYN_FAIL_NOCMD)
-            error_print("Missing command name", FPRINTF);
-        else if (syncheck == SYN_FAIL_MULTREDOUT)
-            error_print("Multiple redirection of standard out", FPRINTF);
-        else if (syncheck == SYN_FAIL_NODESTOUT)
-            error_print("Standard output redirection without file name",
-                        FPRINTF);
-        else if (syncheck == SYN_FAIL_MULTREDIN)
-            error_print("Multiple redirection of standard input", FPRINTF);
-        else if (syncheck == SYN_FAIL_NODESTIN)
-            error_print("Standard input redirection without file name",
-                        FPRINTF);
-        else if (syncheck == SYN_FAIL_INVALIDBG)
-            error_print("Invalid use of background", FPRINTF);
+        else
+        {
+            status_set(EXIT_SYNTAX);
+
+            if (syncheck == SYN_FAIL_NOCMD)
+                error_print("Missing command name", FPRINTF);
+            else if (syncheck == SYN_FAIL_MULTREDOUT)
+                error_print("Multiple redirection of standard out", FPRINTF);
+            else if (syncheck == SYN_FAIL_NODESTOUT)
+                error_print("Standard output redirection without file name",
+                            FPRINTF);
+            else if (syncheck == SYN_FAIL_MULTREDIN)
+                error_print("Multiple redirection of standard input", FPRINTF);
+            else if (syncheck == SYN_FAIL_NODESTIN)
+                error_print("Standard input redirection without file name",
+                            FPRINTF);
+            else if (syncheck == SYN_FAIL_INVALIDBG)
+                error_print("Invalid use of background", FPRINTF);
+        }
         break;
 
     case LEX_QERROR:
         error_print("Unmatched quote", FPRINTF);
+        status_set(EXIT_SYNTAX);
         break;
 
     case LEX_NOMEM:
         error_print("Cannot allocate memory", FPRINTF);
-        break;
-
-    case LEX_LONG:
-        error_print("Command is too large", FPRINTF);
+        status_set(EXIT_FAILURE);
         break;
 
     default:
@@ -235,27 +201,96 @@ static void shell_helper(const char *in_line)
         exit(EXIT_FAILURE);
     }
 
-    /* Free memories allocated to tokens */
-    dynarray_map(oTokens, free_token, NULL);
-    dynarray_free(oTokens);
+    /* Release the line copy and everything built from it at once */
+    arena_reset(line_arena);
+}
+/*---------------------------------------------------------------------------*/
+static void usage(const char *progname)
+{
+    fprintf(stderr, "Usage: %s [-i] [-c command | script]\n", progname);
+    exit(EXIT_SYNTAX);
+}
+/*---------------------------------------------------------------------------*/
+/* Run the command lines of a -c argument one after another. */
+static void run_string(char *cmds)
+{
+    long long start;
+    char *nl;
+
+    while (1)
+    {
+        nl = strchr(cmds, '\n');
+        if (nl != NULL)
+            *nl = '\0';
+
+        if (evloop_wait_input() == EVLOOP_JOBS)
+            jobs_report();
+
+        start = stats_now();
+        shell_helper(cmds);
+        trace_span("line", start, 0, 0, cmds);
+
+        if (nl == NULL)
+            break;
+        cmds = nl + 1;
+    }
 }
 /*---------------------------------------------------------------------------*/
 int main(int argc, char *argv[])
 {
     sigset_t sigset;
-    char c_line[MAX_LINE_SIZE + 2];
-
+    LineReader_T oReader;
+    enum ReadResult rret;
+    char *line, *command = NULL, *trace;
+    long long start;
+    size_t len;
+    int opt, force_interactive = FALSE;
+    int fd = STDIN_FILENO;
+
+    shell_pid = getpid();
     atexit(cleanup);
+    error_print(argv[0], SETUP);
 
-    /* Initialize variables for background processes */
-    total_bg_cnt = 0;
-    memset(&bg_list, 0, sizeof(struct BgProcessList));
-    bg_messages_pending = 0;
+    /* snush [-i] [-c command | script] */
+    while ((opt = getopt(argc, argv, "+ic:")) != -1)
+    {
+        if (opt == 'i')
+            force_interactive = TRUE;
+        else if (opt == 'c')
+            command = optarg;
+        else
+            usage(argv[0]);
+    }
+    if (argc - optind > (command == NULL ? 1 : 0))
+        usage(argv[0]);
+
+    if (optind < argc)
+    {
+        fd = fdreg_open(argv[optind], O_RDONLY, 0);
+        if (fd < 0)
+        {
+            error_print(argv[optind], PERROR);
+            exit(EXIT_EXEC_FAIL);
+        }
+    }
+
+    /* Scripts, -c and piped input run without prompts or job control */
+    interactive = force_interactive ||
+                  (command == NULL && fd == STDIN_FILENO &&
+                   isatty(STDIN_FILENO));
+
+    line_arena = arena_new();
+    oTokens = tokvec_new();
+    oReader = reader_new(fd);
+    if (line_arena == NULL || oTokens == NULL || oReader == NULL)
+    {
+        fprintf(stderr, "%s: Cannot allocate memory\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
 
     /* Set up signal handling */
     sigemptyset(&sigset);
     sigaddset(&sigset, SIGINT);
-    sigaddset(&sigset, SIGCHLD);
     sigaddset(&sigset, SIGQUIT);
     sigaddset(&sigset, SIGTSTP);
     sigaddset(&sigset, SIGTTOU);
@@ -270,10 +305,6 @@ int main(int argc, char *argv[])
     sa.sa_handler = SIG_IGN;
     sigaction(SIGINT, &sa, NULL);
 
-    // SIGCHLD handler
-    sa.sa_handler = sigzombie_handler;
-    sigaction(SIGCHLD, &sa, NULL);
-
     // SIGQUIT handler
     sa.sa_handler = SIG_IGN;
     sigaction(SIGQUIT, &sa, NULL);
@@ -286,41 +317,86 @@ int main(int argc, char *argv[])
     sa.sa_handler = SIG_IGN;
     sigaction(SIGTTOU, &sa, NULL);
 
-    // Make sure the shell is in its own process group and has control of the terminal
-    pid_t shell_pgid = getpid();
-    setpgid(shell_pgid, shell_pgid);
-    tcsetpgrp(STDIN_FILENO, shell_pgid);
+    // SIGCHLD is taken from a signalfd; children are reaped in the loop
+    if (evloop_init(command != NULL ? -1 : fd) < 0)
+    {
+        error_print(NULL, PERROR);
+        exit(EXIT_FAILURE);
+    }
 
-    error_print(argv[0], SETUP);
+    spawn_select_engine();
+
+    trace = getenv("SNUSH_TRACE");
+    if (trace != NULL && trace_open(trace) < 0)
+        error_print(trace, PERROR);
+
+    if (interactive)
+    {
+        // Make sure the shell is in its own process group and has control of the terminal
+        pid_t shell_pgid = getpid();
+        setpgid(shell_pgid, shell_pgid);
+        tcsetpgrp(STDIN_FILENO, shell_pgid);
+
+        // Set stdout to be line buffered
+        setvbuf(stdout, NULL, _IOLBF, 0);
+    }
+    else
+    {
+        // Nobody is watching; commands flush it before they start
+        setvbuf(stdout, NULL, _IOFBF, BUFSIZ);
+    }
 
-    // Set stdout to be line buffered
-    setvbuf(stdout, NULL, _IOLBF, 0);
+    if (command != NULL)
+    {
+        run_string(command);
+        exit(last_status);
+    }
 
     while (1)
     {
-        tcsetpgrp(STDIN_FILENO, getpgrp());
+        if (interactive)
+            tcsetpgrp(STDIN_FILENO, getpgrp());
 
-        if (prompt_needed)
+        if (interactive && prompt_needed)
         {
             fprintf(stdout, "%% ");
             fflush(stdout);
         }
+        prompt_needed = 0;
+        start = stats_now();
+
+        // Report background groups the moment they finish
+        if (!reader_has_line(oReader) &&
+            evloop_wait_input() == EVLOOP_JOBS)
+        {
+            if (interactive)
+                printf("\n");
+            jobs_report();
+            prompt_needed = 1;
+            continue;
+        }
 
         // Read input
-        if (fgets(c_line, MAX_LINE_SIZE, stdin) == NULL)
+        rret = reader_getline(oReader, &line, &len);
+        if (rret == READ_EINTR)
+            continue;
+        if (rret == READ_EOF || rret == READ_ERROR)
         {
-            if (errno == EINTR)
-            {
-                clearerr(stdin);
-                continue;
-            }
-            printf("\n");
-            exit(EXIT_SUCCESS);
+            if (interactive)
+                printf("\n");
+            exit(last_status);
         }
 
-        check_bg_status();
         prompt_needed = 1;
-        shell_helper(c_line);
+        trace_span("read", start, 0, 0, NULL);
+        if (rret == READ_TOOLONG)
+            error_print("Command is too large", FPRINTF);
+        else
+        {
+            start = stats_now();
+            shell_helper(line);
+            trace_span("line", start, 0, 0, line);
+        }
     }
 
     return 0;
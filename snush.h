@@ -24,37 +24,12 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 
-#define MAX_BG_PRO 16
-#define MAX_FG_PRO 16
-extern int total_bg_cnt;
 extern int prompt_needed;
 
-struct BgProcess
-{
-        pid_t pid;  // Process ID
-        pid_t pgid; // Process group ID
-        char *cmd;  // Command string for jobs display
-        int status; // Process status
-};
-struct CompletedProcessGroup
-{
-        pid_t pgid;
-        int printed;
-};
+/* Prompts and terminal job control are only used when interactive */
+extern int interactive;
 
-struct BgProcessList
-{
-        struct BgProcess processes[MAX_BG_PRO];
-        struct CompletedProcessGroup completed[MAX_BG_PRO];
-        int count;
-        int completed_count;
-};
-
-extern struct BgProcessList bg_list;
-
-// Macros for background process management
-#define BG_PROCESS_DONE 1
-#define BG_PROCESS_RUNNING 0
-#define BG_PROCESS_ERROR -1
+/* Exit status of the last command line, as $? would report it */
+extern int last_status;
 
 #endif /* _SNUSH_H_ */
\ No newline at end of file
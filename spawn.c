@@ -0,0 +1,137 @@
+/*---------------------------------------------------------------------------*/
+/* spawn.c                                                                   */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#include <spawn.h>
+#include <signal.h>
+#include <errno.h>
+
+#include "spawn.h"
+#include "cmdhash.h"
+
+enum SpawnEngine spawn_engine = SPAWN_FORK;
+
+/*---------------------------------------------------------------------------*/
+void spawn_select_engine(void) {
+    char *engine = getenv("SNUSH_SPAWN");
+
+    if (engine == NULL || strcmp(engine, "fork") == 0)
+        spawn_engine = SPAWN_FORK;
+    else if (strcmp(engine, "posix") == 0)
+        spawn_engine = SPAWN_POSIX;
+    else {
+        error_print("SNUSH_SPAWN must be \"fork\" or \"posix\"", FPRINTF);
+        spawn_engine = SPAWN_FORK;
+    }
+}
+/*---------------------------------------------------------------------------*/
+/* Queue the file actions that wire up the child's stdin and stdout.
+   Return 0 on success or an error number. */
+static int add_file_actions(posix_spawn_file_actions_t *fa,
+                            struct CommandInfo *cmd,
+                            int fd_in, int fd_out, int fd_close) {
+    int ret = 0;
+
+    if (fd_close != -1)
+        ret = posix_spawn_file_actions_addclose(fa, fd_close);
+
+    if (ret == 0 && fd_in != -1) {
+        ret = posix_spawn_file_actions_adddup2(fa, fd_in, STDIN_FILENO);
+        if (ret == 0)
+            ret = posix_spawn_file_actions_addclose(fa, fd_in);
+    }
+
+    if (ret == 0 && fd_out != -1) {
+        ret = posix_spawn_file_actions_adddup2(fa, fd_out, STDOUT_FILENO);
+        if (ret == 0)
+            ret = posix_spawn_file_actions_addclose(fa, fd_out);
+    }
+
+    if (ret == 0 && cmd->redirect_in != NULL)
+        ret = posix_spawn_file_actions_addopen(fa, STDIN_FILENO,
+                                               cmd->redirect_in,
+                                               O_RDONLY, 0);
+
+    if (ret == 0 && cmd->redirect_out != NULL)
+        ret = posix_spawn_file_actions_addopen(fa, STDOUT_FILENO,
+                                               cmd->redirect_out,
+                                               O_WRONLY | O_CREAT | O_TRUNC,
+                                               0644);
+
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 34)
+    /* Pipeline stages must not inherit any other pipe end */
+    if (ret == 0 && (fd_in != -1 || fd_out != -1))
+        ret = posix_spawn_file_actions_addclosefrom_np(fa, 3);
+#endif
+
+    return ret;
+}
+/*---------------------------------------------------------------------------*/
+pid_t spawn_command(struct CommandInfo *cmd, pid_t pgid,
+                    int fd_in, int fd_out, int fd_close) {
+    posix_spawn_file_actions_t fa;
+    posix_spawnattr_t attr;
+    sigset_t sigdef, sigmask;
+    pid_t pid;
+    int ret;
+
+    /* Same signal setup the fork path does by hand in the child */
+    sigemptyset(&sigdef);
+    sigaddset(&sigdef, SIGINT);
+    sigaddset(&sigdef, SIGQUIT);
+    sigaddset(&sigdef, SIGTSTP);
+    sigaddset(&sigdef, SIGTTIN);
+    sigaddset(&sigdef, SIGTTOU);
+    sigaddset(&sigdef, SIGCHLD);
+    sigemptyset(&sigmask);
+
+    posix_spawnattr_init(&attr);
+    if (pgid >= 0) {
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP |
+                                 POSIX_SPAWN_SETSIGDEF |
+                                 POSIX_SPAWN_SETSIGMASK);
+        posix_spawnattr_setpgroup(&attr, pgid);
+    }
+    else
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF |
+                                 POSIX_SPAWN_SETSIGMASK);
+    posix_spawnattr_setsigdefault(&attr, &sigdef);
+    posix_spawnattr_setsigmask(&attr, &sigmask);
+
+    posix_spawn_file_actions_init(&fa);
+    ret = add_file_actions(&fa, cmd, fd_in, fd_out, fd_close);
+    if (ret == 0) {
+        ret = posix_spawn(&pid, cmd->path, &fa, &attr, cmd->args, environ);
+
+        /* The group leader may already be gone; the fork path ignores
+           a failed setpgid() in that case, so start a new group */
+        if (ret == EPERM && pgid > 0) {
+            posix_spawnattr_setpgroup(&attr, 0);
+            ret = posix_spawn(&pid, cmd->path, &fa, &attr,
+                              cmd->args, environ);
+        }
+
+        /* The remembered location is stale; search PATH once more */
+        if (ret == ENOENT && cmd->path != cmd->args[0]) {
+            cmdhash_forget(cmd->args[0]);
+            cmd->path = cmdhash_lookup(cmd->args[0]);
+            if (cmd->path == NULL)
+                ret = errno;
+            else
+                ret = posix_spawn(&pid, cmd->path, &fa, &attr,
+                                  cmd->args, environ);
+        }
+    }
+
+    posix_spawn_file_actions_destroy(&fa);
+    posix_spawnattr_destroy(&attr);
+
+    if (ret != 0) {
+        errno = ret;
+        return -1;
+    }
+
+    return pid;
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,42 @@
+/*---------------------------------------------------------------------------*/
+/* spawn.h                                                                   */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#ifndef _SPAWN_H_
+#define _SPAWN_H_
+
+#include <sys/types.h>
+
+#include "execute.h"
+
+/* How external commands are started.  SPAWN_FORK is the classic
+   fork() + execvp() path.  SPAWN_POSIX uses posix_spawn(), which glibc
+   implements with clone(CLONE_VM | CLONE_VFORK), so the shell's page
+   tables are never copied. */
+enum SpawnEngine {
+    SPAWN_FORK,
+    SPAWN_POSIX
+};
+
+extern enum SpawnEngine spawn_engine;
+
+/* Select spawn_engine from the SNUSH_SPAWN environment variable
+   ("fork" or "posix").  An unknown value is reported to stderr and
+   leaves the fork engine selected. */
+void spawn_select_engine(void);
+
+/* Start cmd->path with posix_spawn().  The child joins process group
+   pgid (0 creates a new group led by the child, -1 keeps the shell's
+   group), gets the default disposition for the job-control signals
+   and an empty signal mask.
+   If fd_in/fd_out are not -1 they become the child's stdin/stdout,
+   and fd_close (if not -1) is closed in the child.  cmd's redirect_in
+   and redirect_out are opened by the child.  If cmd->path no longer
+   exists it is forgotten and PATH is searched again.
+   Return the child's pid, or -1 with errno set if the command could
+   not be started.  Nothing is printed. */
+pid_t spawn_command(struct CommandInfo *cmd, pid_t pgid,
+                    int fd_in, int fd_out, int fd_close);
+
+#endif /* _SPAWN_H_ */
@@ -0,0 +1,119 @@
+/*---------------------------------------------------------------------------*/
+/* stats.c                                                                   */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#include <string.h>
+#include <time.h>
+
+#include "stats.h"
+
+/* Values below 2 * STATS_SUB_BUCKETS get a bucket each; every larger
+   power of two gets STATS_SUB_BUCKETS of them */
+enum {SUB_BITS = 4};
+enum {BUCKET_CNT = (64 - SUB_BITS) * STATS_SUB_BUCKETS};
+
+struct Histogram {
+    unsigned long long buckets[BUCKET_CNT];
+    unsigned long long count;
+    long long sum;
+    long long max;
+};
+
+static struct Histogram phases[STAT_PHASE_CNT];
+
+static const char *phase_names[STAT_PHASE_CNT] = {
+    "lex", "parse", "plan", "spawn", "wait"
+};
+
+/*---------------------------------------------------------------------------*/
+static int bucket_of(long long value) {
+    int msb, shift;
+
+    if (value < 2 * STATS_SUB_BUCKETS)
+        return value < 0 ? 0 : (int)value;
+
+    msb = 63 - __builtin_clzll((unsigned long long)value);
+    shift = msb - SUB_BITS;
+
+    return (shift + 1) * STATS_SUB_BUCKETS +
+           (int)(value >> shift) - STATS_SUB_BUCKETS;
+}
+/*---------------------------------------------------------------------------*/
+/* Return the largest value that falls in bucket i */
+static long long bucket_top(int i) {
+    int shift;
+
+    if (i < 2 * STATS_SUB_BUCKETS)
+        return i;
+
+    shift = i / STATS_SUB_BUCKETS - 1;
+
+    return ((long long)(i % STATS_SUB_BUCKETS + STATS_SUB_BUCKETS + 1)
+            << shift) - 1;
+}
+/*---------------------------------------------------------------------------*/
+/* Return the value below which fraction of h's values lie */
+static long long percentile(const struct Histogram *h, double fraction) {
+    unsigned long long rank = (unsigned long long)(fraction * h->count);
+    unsigned long long seen = 0;
+    int i;
+
+    if (rank >= h->count)
+        rank = h->count - 1;
+
+    for (i = 0; i < BUCKET_CNT; i++) {
+        seen += h->buckets[i];
+        if (seen > rank)
+            break;
+    }
+
+    /* Never report more than was actually seen */
+    return bucket_top(i) < h->max ? bucket_top(i) : h->max;
+}
+/*---------------------------------------------------------------------------*/
+long long stats_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+/*---------------------------------------------------------------------------*/
+void stats_record(enum StatPhase phase, long long start) {
+    struct Histogram *h = &phases[phase];
+    long long value = stats_now() - start;
+
+    h->buckets[bucket_of(value)]++;
+    h->count++;
+    h->sum += value;
+    if (value > h->max)
+        h->max = value;
+}
+/*---------------------------------------------------------------------------*/
+void stats_print(FILE *fp) {
+    const struct Histogram *h;
+    int i;
+
+    fprintf(fp, "%-8s %10s %12s %12s %12s %12s\n", "phase", "count",
+            "p50(us)", "p99(us)", "max(us)", "mean(us)");
+
+    for (i = 0; i < STAT_PHASE_CNT; i++) {
+        h = &phases[i];
+        if (h->count == 0) {
+            fprintf(fp, "%-8s %10d %12s %12s %12s %12s\n", phase_names[i],
+                    0, "-", "-", "-", "-");
+            continue;
+        }
+
+        fprintf(fp, "%-8s %10llu %12.1f %12.1f %12.1f %12.1f\n",
+                phase_names[i], h->count, percentile(h, 0.50) / 1e3,
+                percentile(h, 0.99) / 1e3, h->max / 1e3,
+                (double)h->sum / h->count / 1e3);
+    }
+}
+/*---------------------------------------------------------------------------*/
+void stats_reset(void) {
+    memset(phases, 0, sizeof(phases));
+}
+/*---------------------------------------------------------------------------*/
@@ -0,0 +1,41 @@
+/*---------------------------------------------------------------------------*/
+/* stats.h                                                                   */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stdio.h>
+
+/* The shell times the phases of running a line and keeps a
+   log-linear histogram of each: values are grouped by power of two,
+   and each power of two is split into STATS_SUB_BUCKETS equal
+   buckets, so any recorded time is known within about 6% whatever its
+   magnitude.  Recording is a clock read and an array increment. */
+
+enum {STATS_SUB_BUCKETS = 16};
+
+enum StatPhase {
+    STAT_LEX,       /* lex_line() */
+    STAT_PARSE,     /* syntax_check() */
+    STAT_PLAN,      /* plan_compile() */
+    STAT_SPAWN,     /* Starting one stage: fork() or posix_spawn() */
+    STAT_WAIT,      /* Waiting for a foreground command or pipeline */
+    STAT_PHASE_CNT
+};
+
+/* Return the current CLOCK_MONOTONIC time in nanoseconds. */
+long long stats_now(void);
+
+/* Record the time elapsed since start, a stats_now() value, for
+   phase. */
+void stats_record(enum StatPhase phase, long long start);
+
+/* Write the count, p50, p99, max and mean of each phase to fp. */
+void stats_print(FILE *fp);
+
+/* Forget everything recorded. */
+void stats_reset(void);
+
+#endif /* _STATS_H_ */
@@ -0,0 +1,184 @@
+/*---------------------------------------------------------------------------*/
+/* status.c                                                                  */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "status.h"
+#include "snush.h"
+
+int pipefail;
+
+/* A one-stage pipeline always fits without allocating */
+static int first_status;
+static int *stage_status = &first_status;
+static int stage_cnt = 1;
+static int stage_cap = 1;
+
+/*---------------------------------------------------------------------------*/
+void status_set(int status) {
+    status_set_pipeline(&status, 1);
+}
+/*---------------------------------------------------------------------------*/
+void status_set_pipeline(const int *statuses, int cnt) {
+    int i, *grown;
+
+    if (cnt > stage_cap) {
+        grown = malloc(sizeof(int) * cnt);
+        if (grown == NULL) {
+            statuses += cnt - 1;
+            cnt = 1;
+        }
+        else {
+            if (stage_status != &first_status)
+                free(stage_status);
+            stage_status = grown;
+            stage_cap = cnt;
+        }
+    }
+
+    memcpy(stage_status, statuses, sizeof(int) * cnt);
+    stage_cnt = cnt;
+
+    last_status = stage_status[cnt - 1];
+    if (pipefail) {
+        for (i = cnt - 1; i >= 0; i--) {
+            if (stage_status[i] != 0) {
+                last_status = stage_status[i];
+                break;
+            }
+        }
+    }
+}
+/*---------------------------------------------------------------------------*/
+/* Append text to out at *len, unless out is NULL, and advance *len */
+static void put_text(char *out, size_t *len, const char *text) {
+    size_t n = strlen(text);
+
+    if (out != NULL)
+        memcpy(out + *len, text, n);
+    *len += n;
+}
+/*---------------------------------------------------------------------------*/
+static void put_status(char *out, size_t *len, int status) {
+    char buf[16];
+
+    snprintf(buf, sizeof(buf), "%d", status);
+    put_text(out, len, buf);
+}
+/*---------------------------------------------------------------------------*/
+/* Expand the parameter s starts with (s follows a '$') into out at
+   *len as put_text() does.  Return how many characters of s it takes
+   up, or 0 if s starts no parameter the shell knows. */
+static int expand_param(const char *s, char *out, size_t *len) {
+    static const char name[] = "PIPESTATUS";
+    const char *p;
+    char *end;
+    long n;
+    int i;
+
+    if (*s == '?') {
+        put_status(out, len, last_status);
+        return 1;
+    }
+
+    /* $PIPESTATUS is its first element, as in bash */
+    if (strncmp(s, name, sizeof(name) - 1) == 0) {
+        p = s + sizeof(name) - 1;
+        if (isalnum((unsigned char)*p) || *p == '_')
+            return 0;
+        put_status(out, len, stage_status[0]);
+        return p - s;
+    }
+
+    if (s[0] != '{' || strncmp(s + 1, name, sizeof(name) - 1) != 0 ||
+        s[sizeof(name)] != '[')
+        return 0;
+    p = s + sizeof(name) + 1;
+
+    if ((*p == '@' || *p == '*') && p[1] == ']' && p[2] == '}') {
+        for (i = 0; i < stage_cnt; i++) {
+            if (i > 0)
+                put_text(out, len, " ");
+            put_status(out, len, stage_status[i]);
+        }
+        return p + 3 - s;
+    }
+
+    if (!isdigit((unsigned char)*p))
+        return 0;
+    n = strtol(p, &end, 10);
+    if (end[0] != ']' || end[1] != '}')
+        return 0;
+
+    /* Stages past the end expand to nothing */
+    if (n < stage_cnt)
+        put_status(out, len, stage_status[n]);
+
+    return end + 2 - s;
+}
+/*---------------------------------------------------------------------------*/
+/* Expand line into out, unless out is NULL, and store the number of
+   parameters expanded in *cnt.  Return the length of the result. */
+static size_t expand(const char *line, char *out, int *cnt) {
+    size_t len = 0;
+    char quote = '\0';
+    int used;
+
+    *cnt = 0;
+    for (; *line != '\0'; line++) {
+        if (*line == '$' && quote != '\'' &&
+            (used = expand_param(line + 1, out, &len)) > 0) {
+            line += used;
+            (*cnt)++;
+            continue;
+        }
+
+        if (*line == '\'' || *line == '\"') {
+            if (quote == '\0')
+                quote = *line;
+            else if (quote == *line)
+                quote = '\0';
+        }
+
+        if (out != NULL)
+            out[len] = *line;
+        len++;
+    }
+
+    return len;
+}
+/*---------------------------------------------------------------------------*/
+const char *status_expand(const char *line, Arena_T oArena) {
+    char *copy;
+    size_t len;
+    int cnt;
+
+    if (strchr(line, '$') == NULL)
+        return line;
+
+    len = expand(line, NULL, &cnt);
+    if (cnt == 0)
+        return line;
+
+    copy = arena_alloc(oArena, len + 1);
+    if (copy == NULL)
+        return NULL;
+    expand(line, copy, &cnt);
+    copy[len] = '\0';
+
+    return copy;
+}
+/*---------------------------------------------------------------------------*/
+void status_free(void) {
+    if (stage_status != &first_status)
+        free(stage_status);
+    stage_status = &first_status;
+    stage_cap = 1;
+    stage_cnt = 1;
+}
+/*---------------------------------------------------------------------------*/
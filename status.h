@@ -0,0 +1,38 @@
+/*---------------------------------------------------------------------------*/
+/* status.h                                                                  */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#ifndef _STATUS_H_
+#define _STATUS_H_
+
+#include "arena.h"
+
+/* The shell keeps the exit status of every stage of the last
+   foreground pipeline; a simple command, a builtin or a line that
+   failed to parse counts as a pipeline of one.  last_status (see
+   snush.h), which $? reports, is derived from them: it is the status
+   of the last stage or, with pipefail set, of the last stage that
+   failed. */
+
+/* Nonzero when "set -o pipefail" is in effect */
+extern int pipefail;
+
+/* Record status as the status of a one-stage pipeline. */
+void status_set(int status);
+
+/* Record the exit statuses of the cnt stages of a pipeline, in order.
+   If insufficient memory is available only the last one is kept. */
+void status_set_pipeline(const int *statuses, int cnt);
+
+/* Return a copy of line, allocated from oArena, in which $?,
+   $PIPESTATUS and ${PIPESTATUS[n]}, ${PIPESTATUS[@]} and
+   ${PIPESTATUS[*]} outside single quotes are replaced by the recorded
+   statuses.  Return line itself if it has nothing to expand, or NULL
+   if insufficient memory is available. */
+const char *status_expand(const char *line, Arena_T oArena);
+
+/* Free the recorded statuses. */
+void status_free(void);
+
+#endif /* _STATUS_H_ */
@@ -3,40 +3,90 @@
 /* Author: Jongki Park, Kyoungsoo Park                                       */
 /*---------------------------------------------------------------------------*/
 
+#include <assert.h>
+
 #include "token.h"
 
+enum {MIN_CAPACITY = 16};
+
 /*---------------------------------------------------------------------------*/
-struct Token *make_one_token(enum TokenType token_type, char *token_value) {
-    struct Token *new_token;
+TokenVec_T tokvec_new(void) {
+    TokenVec_T oTokens;
+
+    oTokens = malloc(sizeof(struct TokenVec));
+    if (oTokens == NULL)
+        return NULL;
 
-    new_token = (struct Token *)malloc(sizeof(struct Token));
-    if (new_token == NULL)
+    oTokens->tokens = malloc(sizeof(struct Token) * MIN_CAPACITY);
+    if (oTokens->tokens == NULL) {
+        free(oTokens);
         return NULL;
+    }
+    oTokens->line = NULL;
+    oTokens->count = 0;
+    oTokens->capacity = MIN_CAPACITY;
+
+    return oTokens;
+}
+/*---------------------------------------------------------------------------*/
+void tokvec_free(TokenVec_T oTokens) {
+    if (oTokens == NULL)
+        return;
+
+    free(oTokens->tokens);
+    free(oTokens);
+}
+/*---------------------------------------------------------------------------*/
+void tokvec_reset(TokenVec_T oTokens, char *line) {
+    assert(oTokens != NULL);
 
-    new_token->token_type = token_type;
+    oTokens->line = line;
+    oTokens->count = 0;
+}
+/*---------------------------------------------------------------------------*/
+int tokvec_add(TokenVec_T oTokens, enum TokenType token_type,
+               int token_offset, int token_length) {
+    struct Token *t;
 
-    if (token_value != NULL) {
-        /* \0 exists at the end of the token_value */
-        new_token->token_value = (char *)malloc(strlen(token_value) + 1);
-        if (new_token->token_value == NULL) {
-            free(new_token);
-            return NULL;
-        }
+    assert(oTokens != NULL);
 
-        strcpy(new_token->token_value, token_value);
+    if (oTokens->count == oTokens->capacity) {
+        t = realloc(oTokens->tokens,
+                    sizeof(struct Token) * oTokens->capacity * 2);
+        if (t == NULL)
+            return 0;
+        oTokens->tokens = t;
+        oTokens->capacity *= 2;
     }
-    else
-        new_token->token_value = NULL;
 
-    return new_token;
+    t = &oTokens->tokens[oTokens->count++];
+    t->token_type = token_type;
+    t->token_offset = token_offset;
+    t->token_length = token_length;
+
+    return 1;
 }
 /*---------------------------------------------------------------------------*/
-void free_token(void *v_item, void *v_extra) {
-    struct Token *psToken = (struct Token *)v_item;
+int tokvec_get_length(TokenVec_T oTokens) {
+    assert(oTokens != NULL);
 
-    if (psToken->token_value != NULL)
-        free(psToken->token_value);
+    return oTokens->count;
+}
+/*---------------------------------------------------------------------------*/
+struct Token *tokvec_get(TokenVec_T oTokens, int iIndex) {
+    assert(oTokens != NULL);
+    assert(iIndex >= 0);
+    assert(iIndex < oTokens->count);
 
-    free(psToken);
+    return &oTokens->tokens[iIndex];
 }
-/*---------------------------------------------------------------------------*/
\ No newline at end of file
+/*---------------------------------------------------------------------------*/
+char *tokvec_get_value(TokenVec_T oTokens, int iIndex) {
+    struct Token *t = tokvec_get(oTokens, iIndex);
+
+    if (t->token_type != TOKEN_WORD)
+        return NULL;
+
+    return oTokens->line + t->token_offset;
+}
+/*---------------------------------------------------------------------------*/
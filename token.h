@@ -14,24 +14,69 @@ enum TokenType {
   TOKEN_REDIN,
   TOKEN_REDOUT,
   TOKEN_WORD,
-  TOKEN_BG
+  TOKEN_BG,
+  TOKEN_FANOUT
 };
 
+/* A Token does not own any text.  It records where its text sits in
+   the line that was lexed. */
 struct Token {
   /* The type of the token. */
   enum TokenType token_type;
 
-  /* The string which is the token's value. */
-  char *token_value;
+  /* Offset and length of the token's text in the line.  Only
+     TOKEN_WORD tokens have text; the others have length 0. */
+  int token_offset;
+  int token_length;
 };
 
-/* Create and return a Token whose type is token_type and whose
-       value consists of string token_value.  Return NULL if insufficient
-       memory is available.  The caller owns the Token. */
-struct Token *make_one_token(enum TokenType token_type, char *token_value);
+/* A TokenVec holds the tokens of one line in a single contiguous
+   array, together with the (mutable) line their text points into.
+   The lexer unquotes words and NUL-terminates them in place, so the
+   text of a WORD token can be used directly as a C string.
+   The array is kept when the TokenVec is reset, so lexing a line does
+   not allocate once the vector has grown to fit. */
+struct TokenVec {
+  char *line;
+  struct Token *tokens;
+  int count;
+  int capacity;
+};
+
+typedef struct TokenVec *TokenVec_T;
+
+
+/* Return a new, empty TokenVec, or NULL if insufficient memory is
+   available. */
+TokenVec_T tokvec_new(void);
+
+
+/* Free oTokens.  The line it points into is not freed. */
+void tokvec_free(TokenVec_T oTokens);
+
+
+/* Empty oTokens and make line the text its tokens refer to. */
+void tokvec_reset(TokenVec_T oTokens, char *line);
+
+
+/* Append a token of type token_type whose text is the token_length
+   bytes at token_offset in the line.  Return 1 on success or 0 if
+   insufficient memory is available. */
+int tokvec_add(TokenVec_T oTokens, enum TokenType token_type,
+               int token_offset, int token_length);
+
+
+/* Return the number of tokens in oTokens. */
+int tokvec_get_length(TokenVec_T oTokens);
+
+
+/* Return the iIndex'th token of oTokens.
+   It is a checked runtime error for iIndex to be out of range. */
+struct Token *tokvec_get(TokenVec_T oTokens, int iIndex);
 
 
-/* Free token v_item.  v_extra is unused. */
-void free_token(void *v_item, void *v_extra);
+/* Return the NUL-terminated text of the iIndex'th token, or NULL if it
+   is not a TOKEN_WORD.  The text lives in the line of oTokens. */
+char *tokvec_get_value(TokenVec_T oTokens, int iIndex);
 
-#endif /* _TOKEN_H_ */
\ No newline at end of file
+#endif /* _TOKEN_H_ */
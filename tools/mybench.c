@@ -0,0 +1,503 @@
+/*
+ * mybench.c - Measures how fast a shell launches commands
+ *
+ * usage: mybench <shell> [n]
+ *        mybench -j <shell>
+ *        mybench -p <shell>
+ *        mybench -b <shell>
+ *        mybench -n <shell>
+ *        mybench -s <shell> [<shell>...]
+ * Feeds <shell> a script of n "/bin/true" lines on stdin, once with
+ * SNUSH_SPAWN=fork and once with SNUSH_SPAWN=posix, and prints the
+ * commands/sec achieved by each spawn engine.
+ *
+ * If n is omitted, it defaults to 2000.
+ *
+ * With -j, stresses the job table instead: for growing n it runs n
+ * "/bin/sleep 1 &" lines followed by one "/bin/sleep 2", so all n
+ * jobs are alive at once and get reaped while the shell waits, and
+ * prints the cost per job beyond that final sleep.  The cost should
+ * stay flat as n grows.
+ *
+ * With -p, measures long pipelines: for 10, 100 and 1000 stages of
+ * "cat" it prints the setup time of a pipeline that carries no data
+ * (start, connect and reap every stage) and the throughput of one
+ * that carries PIPE_BYTES bytes from end to end, setup excluded.  The
+ * scripts start with "set +o native", so every stage is a process of
+ * its own rather than a thread of a native filter helper.
+ *
+ * With -b, measures pipe buffer sizes: for each of PIPEBUF_SIZES it
+ * has snush run "pipebuf=<size> mygen | myrelay | mysink" moving
+ * PIPEBUF_MB megabytes in PIPEBUF_BLOCK blocks, and prints the
+ * throughput and the context switches of all three stages.  A size of
+ * 0 is the kernel default.
+ *
+ * With -n, compares snush's native filters with the real commands:
+ * each of NATIVE_PIPES is run NATIVE_RUNS times over a NATIVE_MB
+ * megabyte text file, once after "set -o native" and once after
+ * "set +o native", and the time per run of each is printed.
+ *
+ * With -s, runs the whole suite against each <shell> in turn and
+ * prints the results as CSV (shell,scenario,param,count,seconds,value,
+ * unit), so shells and builds can be compared by machine:
+ *   simple    SUITE_CMDS "/bin/true" lines, in commands/sec
+ *   pipeline  SUITE_PIPES pipelines of 2 to 16 "cat" stages, in
+ *             microseconds of setup per pipeline, after "set +o
+ *             native" so each stage is exec'd as in the original shell
+ *   jobs      SUITE_JOBS "/bin/true &" lines, in background jobs
+ *             completed (reported Done) per second
+ *   lex       SUITE_LINES lines of SUITE_WORDS words each, which a
+ *             builtin rejects after lexing, in MB/sec
+ *   stream    SUITE_BYTES bytes from mygen through 0 to 4 myrelay
+ *             stages into mysink, in MB/sec
+ * The scenarios stay within what the original shell supports (lines
+ * under 1024 bytes, at most 16 stages), so "make bench" can run them
+ * against sample_snush as well.
+ *
+ * Example: ./mybench ../snush 5000
+ *          ./mybench -j ../snush
+ *          ./mybench -p ../snush
+ *          ./mybench -b ../snush
+ *          ./mybench -n ../snush
+ *          ./mybench -s ../snush ../sample_snush
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#define NCMDS 2000
+#define JOB_SLEEP "/bin/sleep 1 &"
+#define JOB_WAIT "/bin/sleep 2"
+#define JOB_WAIT_SECS 2.0
+#define PIPE_RUNS 10
+#define PIPE_BYTES (4 << 20)
+#define SUITE_CMDS 2000
+#define SUITE_PIPES 100
+#define SUITE_JOBS 500
+#define SUITE_JOBS_WAIT "/bin/sleep 1"
+#define SUITE_LINES 2000
+#define SUITE_WORDS 200
+#define SUITE_BYTES (256 << 20)
+#define PIPEBUF_SIZES { "0", "256K", "1M", "4M" }
+#define PIPEBUF_MB 1024
+#define PIPEBUF_BLOCK "1M"
+#define NATIVE_MB 64
+#define NATIVE_RUNS 20
+#define NATIVE_PIPES { "cat %s | wc -l", "cat %s | grep 4242 | wc -l", \
+                       "cat %s | head -n 10", "cat %s | wc -w" }
+
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Write n copies of line, then tail if it is not NULL, into an
+   unlinked temporary file. */
+static int make_script(const char *line, int n, const char *tail)
+{
+  char path[] = "/tmp/mybenchXXXXXX";
+  int fd = mkstemp(path);
+  FILE *fp;
+
+  if (fd < 0) {
+    perror("mkstemp");
+    exit(EXIT_FAILURE);
+  }
+  unlink(path);
+
+  fp = fdopen(dup(fd), "w");
+  for (int i = 0; i < n; i++)
+    fprintf(fp, "%s\n", line);
+  if (tail != NULL)
+    fprintf(fp, "%s\n", tail);
+  fclose(fp);
+
+  return fd;
+}
+
+/* Append n copies of line to script. */
+static void append_lines(int script, const char *line, int n)
+{
+  FILE *fp = fdopen(dup(script), "w");
+
+  for (int i = 0; i < n; i++)
+    fprintf(fp, "%s\n", line);
+  fclose(fp);
+}
+
+/* Like make_script(), after a line that turns native filters off, so
+   "cat" stages run the real command.  A shell without them just
+   fails that line. */
+static int make_real_script(const char *line, int n)
+{
+  int fd = make_script("set +o native", 1, NULL);
+
+  append_lines(fd, line, n);
+  return fd;
+}
+
+/* Run shell with script on stdin, its output going to out (or
+   nowhere if out is -1) and engine selected; return seconds. */
+static double run_shell_to(const char *shell, int script, const char *engine,
+                           int out)
+{
+  double start = now();
+  pid_t pid;
+  int status;
+
+  lseek(script, 0, SEEK_SET);
+
+  pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    exit(EXIT_FAILURE);
+  }
+  if (pid == 0) {
+    int devnull = open("/dev/null", O_WRONLY);
+
+    dup2(script, STDIN_FILENO);
+    dup2(out >= 0 ? out : devnull, STDOUT_FILENO);
+    dup2(devnull, STDERR_FILENO);
+    setenv("SNUSH_SPAWN", engine, 1);
+    execl(shell, shell, (char *)NULL);
+    _exit(127);
+  }
+
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) == 127) {
+    fprintf(stderr, "mybench: %s did not run correctly\n", shell);
+    exit(EXIT_FAILURE);
+  }
+
+  return now() - start;
+}
+
+/* Run shell with script on stdin and engine selected; return seconds. */
+static double run_shell(const char *shell, int script, const char *engine)
+{
+  return run_shell_to(shell, script, engine, -1);
+}
+
+/* Run growing numbers of concurrent background jobs. */
+static void bench_jobs(const char *shell)
+{
+  const int counts[] = { 250, 500, 1000, 2000 };
+
+  for (int i = 0; i < 4; i++) {
+    int script = make_script(JOB_SLEEP, counts[i], JOB_WAIT);
+    double secs = run_shell(shell, script, "posix");
+
+    printf("jobs   %7d jobs %8.3f s %10.1f us/job\n", counts[i], secs,
+           (secs - JOB_WAIT_SECS) / counts[i] * 1e6);
+    close(script);
+  }
+}
+
+/* Return a pipeline that feeds head's output through n "cat"s. */
+static char *make_pipeline(const char *head, int n)
+{
+  size_t len = strlen(head) + n * strlen(" | cat") + 1;
+  char *line = malloc(len), *p = line;
+
+  if (line == NULL) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+
+  p += sprintf(p, "%s", head);
+  for (int i = 0; i < n; i++)
+    p += sprintf(p, " | cat");
+
+  return line;
+}
+
+/* Run pipelines of growing length. */
+static void bench_pipes(const char *shell)
+{
+  const int stages[] = { 10, 100, 1000 };
+  char head[64];
+
+  snprintf(head, sizeof(head), "head -c %d /dev/zero", PIPE_BYTES);
+
+  for (int i = 0; i < 3; i++) {
+    char *empty = make_pipeline("cat < /dev/null", stages[i] - 1);
+    char *full = make_pipeline(head, stages[i] - 1);
+    int script = make_real_script(empty, PIPE_RUNS);
+    double setup = run_shell(shell, script, "posix") / PIPE_RUNS;
+    double secs;
+
+    close(script);
+    script = make_real_script(full, 1);
+    secs = run_shell(shell, script, "posix") - setup;
+    close(script);
+
+    printf("pipe   %7d stages %8.3f ms setup %8.1f us/stage "
+           "%8.1f MB/s\n", stages[i], setup * 1e3,
+           setup / stages[i] * 1e6, PIPE_BYTES / secs / (1 << 20));
+    free(empty);
+    free(full);
+  }
+}
+
+/* Return the number of lines of the file fd that contain match. */
+static int count_matches(int fd, const char *match)
+{
+  char line[1024];
+  FILE *fp;
+  int cnt = 0;
+
+  lseek(fd, 0, SEEK_SET);
+  fp = fdopen(dup(fd), "r");
+  while (fgets(line, sizeof(line), fp) != NULL)
+    if (strstr(line, match) != NULL)
+      cnt++;
+  fclose(fp);
+
+  return cnt;
+}
+
+static void csv(const char *shell, const char *scenario, int param, int count,
+                double secs, double value, const char *unit)
+{
+  printf("%s,%s,%d,%d,%.6f,%.3f,%s\n", shell, scenario, param, count, secs,
+         value, unit);
+  fflush(stdout);
+}
+
+/* Return the directory mybench was started from, where mygen,
+   myrelay and mysink are. */
+static const char *tool_dir(void)
+{
+  static char dir[4096];
+  char *slash;
+  ssize_t len;
+
+  if (dir[0] == '\0') {
+    len = readlink("/proc/self/exe", dir, sizeof(dir) - 1);
+    if (len < 0) {
+      perror("readlink");
+      exit(EXIT_FAILURE);
+    }
+    dir[len] = '\0';
+    if ((slash = strrchr(dir, '/')) != NULL)
+      *slash = '\0';
+  }
+
+  return dir;
+}
+
+/* Run every scenario against shell and print CSV rows. */
+static void bench_suite(const char *shell)
+{
+  const int stages[] = { 2, 4, 8, 16 };
+  const int relays[] = { 0, 1, 4 };
+  char *line, *p;
+  int script, out;
+  double secs;
+
+  script = make_script("/bin/true", SUITE_CMDS, NULL);
+  secs = run_shell(shell, script, "posix");
+  csv(shell, "simple", 1, SUITE_CMDS, secs, SUITE_CMDS / secs, "cmds/s");
+  close(script);
+
+  for (int i = 0; i < 4; i++) {
+    line = make_pipeline("cat < /dev/null", stages[i] - 1);
+    script = make_real_script(line, SUITE_PIPES);
+    secs = run_shell(shell, script, "posix");
+    csv(shell, "pipeline", stages[i], SUITE_PIPES, secs,
+        secs / SUITE_PIPES * 1e6, "us/pipeline");
+    close(script);
+    free(line);
+  }
+
+  /* Only jobs the shell reported Done count, since a shell may refuse
+     some while too many are running; the wait that lets the last ones
+     finish is timed on its own and taken off */
+  script = make_script("", 0, SUITE_JOBS_WAIT);
+  secs = -run_shell(shell, script, "posix");
+  close(script);
+  script = make_script("/bin/true &", SUITE_JOBS, SUITE_JOBS_WAIT);
+  out = make_script("", 0, NULL);
+  secs += run_shell_to(shell, script, "posix", out);
+  csv(shell, "jobs", SUITE_JOBS, count_matches(out, "Done"), secs,
+      count_matches(out, "Done") / secs, "jobs/s");
+  close(script);
+  close(out);
+
+  /* "cd" rejects more than one argument, so only lexing and parsing
+     do real work */
+  line = malloc(3 + SUITE_WORDS * 5);
+  if (line == NULL) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+  p = line + sprintf(line, "cd");
+  for (int i = 0; i < SUITE_WORDS; i++)
+    p += sprintf(p, " w%03d", i);
+  script = make_script(line, SUITE_LINES, NULL);
+  secs = run_shell(shell, script, "posix");
+  csv(shell, "lex", SUITE_WORDS, SUITE_LINES, secs,
+      (double)SUITE_LINES * (strlen(line) + 1) / secs / (1 << 20), "MB/s");
+  close(script);
+  free(line);
+
+  line = malloc(4 * strlen(tool_dir()) + 256);
+  if (line == NULL) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+  for (int i = 0; i < 3; i++) {
+    p = line + sprintf(line, "%s/mygen %d", tool_dir(), SUITE_BYTES);
+    for (int j = 0; j < relays[i]; j++)
+      p += sprintf(p, " | %s/myrelay", tool_dir());
+    sprintf(p, " | %s/mysink", tool_dir());
+    script = make_script(line, 1, NULL);
+    secs = run_shell(shell, script, "posix");
+    csv(shell, "stream", relays[i], SUITE_BYTES, secs,
+        SUITE_BYTES / secs / (1 << 20), "MB/s");
+    close(script);
+  }
+  free(line);
+}
+
+/* Run a generator and sink pair with several pipe buffer sizes. */
+static void bench_pipebuf(const char *shell)
+{
+  const char *sizes[] = PIPEBUF_SIZES;
+  const char *dir = tool_dir();
+  struct rusage before, after;
+  char *line;
+  double secs;
+  long ctxsw;
+  int script;
+
+  line = malloc(3 * strlen(dir) + 256);
+  if (line == NULL) {
+    perror("malloc");
+    exit(EXIT_FAILURE);
+  }
+
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    sprintf(line, "pipebuf=%s %s/mygen -b %s %dM | %s/myrelay -b %s | "
+            "%s/mysink -b %s", sizes[i], dir, PIPEBUF_BLOCK, PIPEBUF_MB,
+            dir, PIPEBUF_BLOCK, dir, PIPEBUF_BLOCK);
+    script = make_script(line, 1, NULL);
+
+    /* The shell waits for the stages, so their usage reaches us */
+    getrusage(RUSAGE_CHILDREN, &before);
+    secs = run_shell(shell, script, "posix");
+    getrusage(RUSAGE_CHILDREN, &after);
+    ctxsw = (after.ru_nvcsw - before.ru_nvcsw) +
+            (after.ru_nivcsw - before.ru_nivcsw);
+
+    printf("pipebuf %5s %8.1f MB/s %10ld ctxsw\n", sizes[i],
+           PIPEBUF_MB / secs, ctxsw);
+    close(script);
+  }
+  free(line);
+}
+
+/* Return an open, unlinked file of NATIVE_MB megabytes of numbered
+   text lines, and store its /proc/self/fd path in path. */
+static int make_text(char *path, size_t size)
+{
+  int fd = make_script("", 0, NULL);
+  FILE *fp = fdopen(dup(fd), "w");
+  long long i;
+
+  for (i = 0; ftell(fp) < (long)NATIVE_MB << 20; i++)
+    fprintf(fp, "line %lld of the native filter benchmark\n", i);
+  fclose(fp);
+  snprintf(path, size, "/proc/%d/fd/%d", (int)getpid(), fd);
+
+  return fd;
+}
+
+/* Run common pipelines with native filters on and off. */
+static void bench_native(const char *shell)
+{
+  const char *pipes[] = NATIVE_PIPES;
+  const char *modes[] = { "set +o native", "set -o native" };
+  char path[64], line[256];
+  double secs[2];
+  int text, script;
+
+  text = make_text(path, sizeof(path));
+
+  for (size_t i = 0; i < sizeof(pipes) / sizeof(pipes[0]); i++) {
+    snprintf(line, sizeof(line), pipes[i], path);
+    for (int m = 0; m < 2; m++) {
+      /* The mode line, then the runs written after it */
+      script = make_script(modes[m], 1, NULL);
+      append_lines(script, line, NATIVE_RUNS);
+      secs[m] = run_shell(shell, script, "posix");
+      close(script);
+    }
+    printf("%-32s %9.2f ms real %9.2f ms native %6.2fx\n", pipes[i],
+           secs[0] / NATIVE_RUNS * 1e3, secs[1] / NATIVE_RUNS * 1e3,
+           secs[0] / secs[1]);
+  }
+  close(text);
+}
+
+int main(int argc, char *argv[])
+{
+  const char *engines[] = { "fork", "posix" };
+  int n, script;
+
+  if (argc == 3 && strcmp(argv[1], "-j") == 0) {
+    bench_jobs(argv[2]);
+    return EXIT_SUCCESS;
+  }
+  if (argc == 3 && strcmp(argv[1], "-p") == 0) {
+    bench_pipes(argv[2]);
+    return EXIT_SUCCESS;
+  }
+  if (argc == 3 && strcmp(argv[1], "-n") == 0) {
+    bench_native(argv[2]);
+    return EXIT_SUCCESS;
+  }
+  if (argc == 3 && strcmp(argv[1], "-b") == 0) {
+    bench_pipebuf(argv[2]);
+    return EXIT_SUCCESS;
+  }
+  if (argc >= 3 && strcmp(argv[1], "-s") == 0) {
+    printf("shell,scenario,param,count,seconds,value,unit\n");
+    for (int i = 2; i < argc; i++)
+      bench_suite(argv[i]);
+    return EXIT_SUCCESS;
+  }
+
+  if (argc < 2 || argc > 3) {
+    fprintf(stderr, "Usage: %s <shell> [n]\n"
+            "       %s -j <shell>\n"
+            "       %s -p <shell>\n"
+            "       %s -b <shell>\n"
+            "       %s -n <shell>\n"
+            "       %s -s <shell> [<shell>...]\n",
+            argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  n = argc == 3 ? atoi(argv[2]) : NCMDS;
+
+  script = make_script("/bin/true", n, NULL);
+
+  for (int i = 0; i < 2; i++) {
+    double secs = run_shell(argv[1], script, engines[i]);
+
+    printf("%-6s %7d cmds %8.3f s %10.1f cmds/s\n",
+           engines[i], n, secs, n / secs);
+  }
+
+  close(script);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,97 @@
+/*
+ * myfdcheck.c - Checks that a shell leaks no file descriptors
+ *
+ * usage: myfdcheck
+ *        myfdcheck -n <count> <command> [args...]
+ * Lists every descriptor above stderr that it was started with and
+ * exits with status 1 if there is any, or prints "no leaked
+ * descriptors" and exits with status 0.
+ *
+ * With -n, opens <count> descriptors on /dev/null (raising the fd
+ * limit if needed) and execs <command> with them.  A shell started
+ * this way has its own descriptors numbered above <count>, which shows
+ * whether its children close high descriptors too.
+ *
+ * Example: ./tools/myfdcheck -n 300 ./snush -c "./tools/myfdcheck | cat"
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/resource.h>
+
+static int check(void)
+{
+  DIR *dir = opendir("/proc/self/fd");
+  struct dirent *d;
+  char path[64], target[256];
+  int fd, leaked = 0;
+  ssize_t len;
+
+  if (dir == NULL) {
+    perror("myfdcheck: /proc/self/fd");
+    return EXIT_FAILURE;
+  }
+
+  while ((d = readdir(dir)) != NULL) {
+    if (d->d_name[0] == '.')
+      continue;
+    fd = atoi(d->d_name);
+    if (fd <= STDERR_FILENO || fd == dirfd(dir))
+      continue;
+
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", fd);
+    len = readlink(path, target, sizeof(target) - 1);
+    target[len < 0 ? 0 : len] = '\0';
+    printf("myfdcheck: leaked descriptor %d -> %s\n", fd, target);
+    leaked++;
+  }
+  closedir(dir);
+
+  if (leaked == 0)
+    printf("myfdcheck: no leaked descriptors\n");
+
+  return leaked == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static void spawn_with_fds(int count, char *argv[])
+{
+  struct rlimit rl;
+
+  getrlimit(RLIMIT_NOFILE, &rl);
+  if (rl.rlim_cur < (rlim_t)count + 64) {
+    rl.rlim_cur = count + 64;
+    if (rl.rlim_max < rl.rlim_cur)
+      rl.rlim_max = rl.rlim_cur;
+    setrlimit(RLIMIT_NOFILE, &rl);
+  }
+
+  for (int i = 0; i < count; i++) {
+    if (open("/dev/null", O_RDONLY) < 0) {
+      perror("myfdcheck: /dev/null");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  execvp(argv[0], argv);
+  perror(argv[0]);
+  exit(127);
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc == 1)
+    return check();
+
+  if (argc < 4 || strcmp(argv[1], "-n") != 0) {
+    fprintf(stderr, "Usage: %s\n"
+            "       %s -n <count> <command> [args...]\n", argv[0], argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  spawn_with_fds(atoi(argv[2]), &argv[3]);
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,138 @@
+/*
+ * mygen.c - Writes a stream of data for pipeline benchmarks
+ *
+ * usage: mygen [-b <block>] [-r <rate>] <bytes>
+ * Writes <bytes> bytes to stdout in blocks of <block> bytes (64K by
+ * default), at most <rate> bytes per second if -r is given.  Sizes
+ * take a K, M or G suffix (powers of 1024).
+ *
+ * Every block of at least 16 bytes starts with the magic "mygenblk"
+ * and the CLOCK_MONOTONIC time in nanoseconds at which it was written,
+ * so mysink, reading blocks of the same size, can tell how long each
+ * one took to get through the pipeline.  The rest of a block is filler.
+ *
+ * Example: ./mygen -b 64K 1G | ./myrelay | ./mysink -b 64K
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define MAGIC "mygenblk"
+#define DEFAULT_BLOCK (64 << 10)
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Return the size s names, or -1 if it is not a size. */
+static long long parse_size(const char *s)
+{
+  char *end;
+  long long n = strtoll(s, &end, 10);
+
+  switch (*end) {
+  case 'G': case 'g': n <<= 10; /* fall through */
+  case 'M': case 'm': n <<= 10; /* fall through */
+  case 'K': case 'k': n <<= 10; end++; break;
+  }
+
+  return end == s || *end != '\0' || n < 0 ? -1 : n;
+}
+
+static void usage(const char *prog)
+{
+  fprintf(stderr, "Usage: %s [-b <block>] [-r <rate>] <bytes>\n", prog);
+  exit(EXIT_FAILURE);
+}
+
+/* Write all len bytes of buf to stdout; return -1 on error. */
+static int write_all(const char *buf, size_t len)
+{
+  ssize_t n;
+
+  while (len > 0) {
+    n = write(STDOUT_FILENO, buf, len);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    buf += n;
+    len -= n;
+  }
+
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  long long block = DEFAULT_BLOCK, rate = 0, total, sent = 0;
+  uint64_t start, due, t;
+  struct timespec ts;
+  char *buf;
+  size_t len;
+  int c;
+
+  while ((c = getopt(argc, argv, "b:r:")) != -1) {
+    switch (c) {
+    case 'b':
+      if ((block = parse_size(optarg)) <= 0)
+        usage(argv[0]);
+      break;
+    case 'r':
+      if ((rate = parse_size(optarg)) <= 0)
+        usage(argv[0]);
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+  if (optind != argc - 1 || (total = parse_size(argv[optind])) < 0)
+    usage(argv[0]);
+
+  buf = malloc(block);
+  if (buf == NULL) {
+    perror("mygen: malloc");
+    exit(EXIT_FAILURE);
+  }
+  for (long long i = 0; i < block; i++)
+    buf[i] = 'a' + i % 26;
+
+  start = now_ns();
+  while (sent < total) {
+    len = total - sent < block ? total - sent : block;
+
+    /* Wait until this block is due at the requested rate */
+    if (rate > 0) {
+      due = start + (uint64_t)((double)sent / rate * 1e9);
+      if ((t = now_ns()) < due) {
+        ts.tv_sec = (due - t) / 1000000000;
+        ts.tv_nsec = (due - t) % 1000000000;
+        nanosleep(&ts, NULL);
+      }
+    }
+
+    if (len >= 16) {
+      t = now_ns();
+      memcpy(buf, MAGIC, 8);
+      memcpy(buf + 8, &t, 8);
+    }
+    if (write_all(buf, len) < 0) {
+      perror("mygen: write");
+      exit(EXIT_FAILURE);
+    }
+    sent += len;
+  }
+
+  free(buf);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,126 @@
+/*
+ * myrelay.c - Copies stdin to stdout at a configurable cost
+ *
+ * usage: myrelay [-b <block>] [-w <passes>] [-d <usecs>]
+ * Copies stdin to stdout unchanged, reading up to <block> bytes at a
+ * time (64K by default; a size takes a K, M or G suffix).  With -w it
+ * also reads every byte of each chunk <passes> times, as a filter that
+ * does that much work would, and with -d it sleeps <usecs>
+ * microseconds per chunk, as one that waits on something would.
+ * Without either it measures what a pipeline stage costs by itself.
+ *
+ * Example: ./mygen 1G | ./myrelay -w 1 | ./myrelay | ./mysink
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define DEFAULT_BLOCK (64 << 10)
+
+/* Return the size s names, or -1 if it is not a size. */
+static long long parse_size(const char *s)
+{
+  char *end;
+  long long n = strtoll(s, &end, 10);
+
+  switch (*end) {
+  case 'G': case 'g': n <<= 10; /* fall through */
+  case 'M': case 'm': n <<= 10; /* fall through */
+  case 'K': case 'k': n <<= 10; end++; break;
+  }
+
+  return end == s || *end != '\0' || n < 0 ? -1 : n;
+}
+
+static void usage(const char *prog)
+{
+  fprintf(stderr, "Usage: %s [-b <block>] [-w <passes>] [-d <usecs>]\n",
+          prog);
+  exit(EXIT_FAILURE);
+}
+
+/* Write all len bytes of buf to stdout; return -1 on error. */
+static int write_all(const char *buf, size_t len)
+{
+  ssize_t n;
+
+  while (len > 0) {
+    n = write(STDOUT_FILENO, buf, len);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    buf += n;
+    len -= n;
+  }
+
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  long long block = DEFAULT_BLOCK, passes = 0, delay = 0;
+  volatile unsigned char sum = 0;
+  ssize_t n;
+  char *buf;
+  int c;
+
+  while ((c = getopt(argc, argv, "b:w:d:")) != -1) {
+    switch (c) {
+    case 'b':
+      if ((block = parse_size(optarg)) <= 0)
+        usage(argv[0]);
+      break;
+    case 'w':
+      if ((passes = parse_size(optarg)) < 0)
+        usage(argv[0]);
+      break;
+    case 'd':
+      if ((delay = parse_size(optarg)) < 0)
+        usage(argv[0]);
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+  if (optind != argc)
+    usage(argv[0]);
+
+  buf = malloc(block);
+  if (buf == NULL) {
+    perror("myrelay: malloc");
+    exit(EXIT_FAILURE);
+  }
+
+  for (;;) {
+    n = read(STDIN_FILENO, buf, block);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+
+    for (long long p = 0; p < passes; p++) {
+      unsigned char s = 0;
+      for (ssize_t i = 0; i < n; i++)
+        s ^= buf[i];
+      sum ^= s;
+    }
+    if (delay > 0)
+      usleep(delay);
+
+    if (write_all(buf, n) < 0) {
+      perror("myrelay: write");
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (n < 0) {
+    perror("myrelay: read");
+    exit(EXIT_FAILURE);
+  }
+
+  free(buf);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,137 @@
+/*
+ * mysink.c - Drains a stream and reports its throughput
+ *
+ * usage: mysink [-b <block>]
+ * Reads stdin to end of file in blocks of <block> bytes (64K by
+ * default; a size takes a K, M or G suffix), then prints the number
+ * of bytes read, the throughput since it started and, for the blocks
+ * mygen stamped, percentiles of the time each took from being written
+ * by mygen to being read here.  <block> should match the block size
+ * given to mygen, or no stamp will be found where it is looked for.
+ *
+ * Example: ./mygen 1G | ./mysink
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define MAGIC "mygenblk"
+#define DEFAULT_BLOCK (64 << 10)
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Return the size s names, or -1 if it is not a size. */
+static long long parse_size(const char *s)
+{
+  char *end;
+  long long n = strtoll(s, &end, 10);
+
+  switch (*end) {
+  case 'G': case 'g': n <<= 10; /* fall through */
+  case 'M': case 'm': n <<= 10; /* fall through */
+  case 'K': case 'k': n <<= 10; end++; break;
+  }
+
+  return end == s || *end != '\0' || n < 0 ? -1 : n;
+}
+
+/* Read up to len bytes into buf, stopping early only at end of file;
+   return the number read, or -1 on error. */
+static ssize_t read_full(char *buf, size_t len)
+{
+  size_t got = 0;
+  ssize_t n;
+
+  while (got < len) {
+    n = read(STDIN_FILENO, buf + got, len - got);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    if (n == 0)
+      break;
+    got += n;
+  }
+
+  return got;
+}
+
+static int compare(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+  return x < y ? -1 : x > y;
+}
+
+int main(int argc, char *argv[])
+{
+  long long block = DEFAULT_BLOCK, bytes = 0;
+  uint64_t start, stamp, *lat = NULL;
+  size_t lat_cnt = 0, lat_cap = 0;
+  double secs;
+  ssize_t n;
+  char *buf;
+  int c;
+
+  while ((c = getopt(argc, argv, "b:")) != -1) {
+    if (c != 'b' || (block = parse_size(optarg)) <= 0) {
+      fprintf(stderr, "Usage: %s [-b <block>]\n", argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  buf = malloc(block);
+  if (buf == NULL) {
+    perror("mysink: malloc");
+    exit(EXIT_FAILURE);
+  }
+
+  start = now_ns();
+  while ((n = read_full(buf, block)) > 0) {
+    bytes += n;
+    if (n < 16 || memcmp(buf, MAGIC, 8) != 0)
+      continue;
+
+    memcpy(&stamp, buf + 8, 8);
+    if (lat_cnt == lat_cap) {
+      lat_cap = lat_cap ? lat_cap * 2 : 1024;
+      lat = realloc(lat, sizeof(uint64_t) * lat_cap);
+      if (lat == NULL) {
+        perror("mysink: realloc");
+        exit(EXIT_FAILURE);
+      }
+    }
+    lat[lat_cnt++] = now_ns() - stamp;
+  }
+  if (n < 0) {
+    perror("mysink: read");
+    exit(EXIT_FAILURE);
+  }
+  secs = (now_ns() - start) / 1e9;
+
+  printf("%lld bytes in %.3f s, %.1f MB/s\n",
+         bytes, secs, secs > 0 ? bytes / secs / (1 << 20) : 0.0);
+  if (lat_cnt > 0) {
+    qsort(lat, lat_cnt, sizeof(uint64_t), compare);
+    printf("latency (us) of %zu blocks: p50 %.1f p90 %.1f p99 %.1f "
+           "max %.1f\n", lat_cnt,
+           lat[lat_cnt * 50 / 100] / 1e3, lat[lat_cnt * 90 / 100] / 1e3,
+           lat[lat_cnt * 99 / 100] / 1e3, lat[lat_cnt - 1] / 1e3);
+  }
+
+  free(lat);
+  free(buf);
+  return EXIT_SUCCESS;
+}
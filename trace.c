@@ -0,0 +1,146 @@
+/*---------------------------------------------------------------------------*/
+/* trace.c                                                                   */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "trace.h"
+#include "stats.h"
+#include "fdreg.h"
+
+enum {TRACE_BUF_SIZE = 64 * 1024};
+
+/* Longest detail string written, so one event always fits the buffer */
+enum {MAX_DETAIL = 256};
+
+static int trace_fd = -1;
+static pid_t shell_pid;
+static int event_cnt;
+
+static char buf[TRACE_BUF_SIZE];
+static size_t buf_len;
+
+/*---------------------------------------------------------------------------*/
+static void flush(void) {
+    size_t done = 0;
+    ssize_t n;
+
+    while (done < buf_len) {
+        n = write(trace_fd, buf + done, buf_len - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        done += n;
+    }
+    buf_len = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void put(const char *s, size_t len) {
+    if (buf_len + len > TRACE_BUF_SIZE)
+        flush();
+    memcpy(buf + buf_len, s, len);
+    buf_len += len;
+}
+/*---------------------------------------------------------------------------*/
+/* Append s as a JSON string */
+static void put_string(const char *s) {
+    char esc[8];
+    int i;
+
+    put("\"", 1);
+    for (i = 0; s[i] != '\0' && i < MAX_DETAIL; i++) {
+        if (s[i] == '\"' || s[i] == '\\') {
+            esc[0] = '\\';
+            esc[1] = s[i];
+            put(esc, 2);
+        }
+        else if ((unsigned char)s[i] < 0x20) {
+            snprintf(esc, sizeof(esc), "\\u%04x", (unsigned char)s[i]);
+            put(esc, 6);
+        }
+        else
+            put(&s[i], 1);
+    }
+    put("\"", 1);
+}
+/*---------------------------------------------------------------------------*/
+static void event(const char *name, const char *phase, long long start,
+                  long long dur, pid_t pid, pid_t pgid, const char *detail) {
+    char head[192];
+    int n;
+
+    n = snprintf(head, sizeof(head),
+                 "%s{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%lld.%03lld,",
+                 event_cnt++ > 0 ? ",\n" : "", name, phase,
+                 start / 1000, start % 1000);
+    put(head, n);
+
+    if (dur >= 0)
+        n = snprintf(head, sizeof(head), "\"dur\":%lld.%03lld,",
+                     dur / 1000, dur % 1000);
+    else
+        n = snprintf(head, sizeof(head), "\"s\":\"t\",");
+    put(head, n);
+
+    n = snprintf(head, sizeof(head), "\"pid\":%d,\"tid\":%d,\"args\":{",
+                 (int)shell_pid, (int)shell_pid);
+    put(head, n);
+
+    n = 0;
+    if (pid > 0)
+        n += snprintf(head + n, sizeof(head) - n, "\"pid\":%d", (int)pid);
+    if (pgid > 0)
+        n += snprintf(head + n, sizeof(head) - n, "%s\"pgid\":%d",
+                      n > 0 ? "," : "", (int)pgid);
+    if (detail != NULL)
+        n += snprintf(head + n, sizeof(head) - n, "%s\"detail\":",
+                      n > 0 ? "," : "");
+    put(head, n);
+    if (detail != NULL)
+        put_string(detail);
+    put("}}", 2);
+}
+/*---------------------------------------------------------------------------*/
+int trace_open(const char *path) {
+    trace_fd = fdreg_open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (trace_fd < 0)
+        return -1;
+
+    shell_pid = getpid();
+    put("[\n", 2);
+
+    return 0;
+}
+/*---------------------------------------------------------------------------*/
+void trace_close(void) {
+    if (trace_fd < 0)
+        return;
+
+    put("\n]\n", 3);
+    flush();
+    fdreg_close(trace_fd);
+    trace_fd = -1;
+}
+/*---------------------------------------------------------------------------*/
+void trace_span(const char *name, long long start, pid_t pid, pid_t pgid,
+                const char *detail) {
+    if (trace_fd < 0)
+        return;
+
+    event(name, "X", start, stats_now() - start, pid, pgid, detail);
+}
+/*---------------------------------------------------------------------------*/
+void trace_instant(const char *name, pid_t pid, pid_t pgid,
+                   const char *detail) {
+    if (trace_fd < 0)
+        return;
+
+    event(name, "i", stats_now(), -1, pid, pgid, detail);
+}
+/*---------------------------------------------------------------------------*/
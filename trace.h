@@ -0,0 +1,38 @@
+/*---------------------------------------------------------------------------*/
+/* trace.h                                                                   */
+/* Author: Jongki Park, Kyoungsoo Park                                       */
+/*---------------------------------------------------------------------------*/
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <sys/types.h>
+
+/* With SNUSH_TRACE=path the shell writes a timeline of what it does
+   to path in the Chrome trace-event format (a JSON array), which
+   Perfetto and chrome://tracing can load.  Events are formatted into
+   a buffer that is written out when it fills and at exit, so tracing
+   costs no system call per event.  When no trace is open every trace
+   function returns at once.
+
+   Times are CLOCK_MONOTONIC nanoseconds, e.g. from stats_now().  An
+   event may carry the pid and pgid of a child and a detail string
+   (a command name or line); 0 and NULL leave them out. */
+
+/* Start writing a trace to path.  Return 0 on success or -1 with errno
+   set. */
+int trace_open(const char *path);
+
+/* Write out what is buffered, end the JSON array and close the
+   trace. */
+void trace_close(void);
+
+/* Record a span named name from start until now. */
+void trace_span(const char *name, long long start, pid_t pid, pid_t pgid,
+                const char *detail);
+
+/* Record an instant event named name. */
+void trace_instant(const char *name, pid_t pid, pid_t pgid,
+                   const char *detail);
+
+#endif /* _TRACE_H_ */
@@ -4,6 +4,7 @@
 /*---------------------------------------------------------------------------*/
 
 #include "util.h"
+#include "builtin.h"
 
 /*---------------------------------------------------------------------------*/
 void error_print(char *input, enum PrintMode mode) {
@@ -35,44 +36,14 @@ void error_print(char *input, enum PrintMode mode) {
     }
 }
 /*---------------------------------------------------------------------------*/
-enum BuiltinType check_builtin(struct Token *t) {
-    /* Check null input before using string functions  */
-    assert(t);
-    assert(t->token_value);
-
-    if (strncmp(t->token_value, "cd", 2) == 0 && strlen(t->token_value) == 2)
-        return B_CD;
-    if (strncmp(t->token_value, "exit", 4) == 0 && strlen(t->token_value) == 4)
-        return B_EXIT;
-    else
-        return NORMAL;
-}
-/*---------------------------------------------------------------------------*/
-int count_pipe(DynArray_T oTokens) {
-    int cnt = 0, i;
-    struct Token *t;
-
-    for (i = 0; i < dynarray_get_length(oTokens); i++)
-    {
-        t = dynarray_get(oTokens, i);
-        if (t->token_type == TOKEN_PIPE)
-            cnt++;
-    }
+enum BuiltinType check_builtin(const char *cmd) {
+    const struct Builtin *b;
 
-    return cnt;
-}
-/*---------------------------------------------------------------------------*/
-/* Check if the user demands it to run as background processes */
-int check_bg(DynArray_T oTokens) {
-    int i;
-    struct Token *t;
+    /* Check null input before using string functions  */
+    assert(cmd);
 
-    for (i = 0; i < dynarray_get_length(oTokens); i++) {
-        t = dynarray_get(oTokens, i);
-        if (t->token_type == TOKEN_BG)
-            return 1;
-    }
-    return 0;
+    b = builtin_find(cmd);
+    return b != NULL ? b->type : NORMAL;
 }
 /*---------------------------------------------------------------------------*/
 const char *special_token_to_str(struct Token *sp_token) {
@@ -81,6 +52,9 @@ const char *special_token_to_str(struct Token *sp_token) {
     case TOKEN_PIPE:
         return "TOKEN_PIPE(|)";
         break;
+    case TOKEN_FANOUT:
+        return "TOKEN_FANOUT(|+)";
+        break;
     case TOKEN_REDIN:
         return "TOKEN_REDIRECTION_IN(<)";
         break;
@@ -98,18 +72,18 @@ const char *special_token_to_str(struct Token *sp_token) {
     }
 }
 /*---------------------------------------------------------------------------*/
-void dump_lex(DynArray_T oTokens) {
+void dump_lex(TokenVec_T oTokens) {
     if (getenv("DEBUG") != NULL) {
         int i;
         struct Token *t;
 
-        for (i = 0; i < dynarray_get_length(oTokens); i++) {
-            t = dynarray_get(oTokens, i);
-            if (t->token_value == NULL)
+        for (i = 0; i < tokvec_get_length(oTokens); i++) {
+            t = tokvec_get(oTokens, i);
+            if (t->token_type != TOKEN_WORD)
                 fprintf(stderr, "[%d] %s\n", i, special_token_to_str(t));
             else
-                fprintf(stderr, 
-                            "[%d] TOKEN_WORD(\"%s\")\n", i, t->token_value);
+                fprintf(stderr, "[%d] TOKEN_WORD(\"%s\")\n",
+                        i, tokvec_get_value(oTokens, i));
         }
     }
 }
@@ -13,7 +13,6 @@
 #include <errno.h>
 
 #include "token.h"
-#include "dynarray.h"
 
 enum
 {
@@ -26,7 +25,10 @@ enum BuiltinType
     NORMAL,
     B_EXIT,
     B_CD,
-    B_JOBS
+    B_JOBS,
+    B_HASH,
+    B_SET,
+    B_STATS
 };
 enum PrintMode
 {
@@ -36,9 +38,7 @@ enum PrintMode
 };
 
 void error_print(char *input, enum PrintMode mode);
-enum BuiltinType check_builtin(struct Token *t);
-int count_pipe(DynArray_T oTokens);
-int check_bg(DynArray_T oTokens);
-void dump_lex(DynArray_T oTokens);
+enum BuiltinType check_builtin(const char *cmd);
+void dump_lex(TokenVec_T oTokens);
 
 #endif /* _UTIL_H_ */
\ No newline at end of file